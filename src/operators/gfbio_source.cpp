@@ -19,6 +19,7 @@
 #include <json/json.h>
 #include <pqxx/pqxx>
 #include <math.h>
+#include <algorithm>
 
 /**
  * This operator fetches GBIF occurrences and IUCN expert rangesdirectly from postgres. It should eventually be replaced by a
@@ -28,6 +29,8 @@
  * 	- dataSource: gbif | iucn
  * 	- term: the search term
  * 	- level: the taxonomy level (family, kingdom, species, ...)
+ * 	- terms: array of {term, level} objects to query several taxa at once (instead of term and level).
+ * 	         The textual attribute `term` identifies the term that matched an occurrence.
  * 	- columns:
  * 		- numeric: array of column names of numeric type
  * 		- textual: array of column names of textual type
@@ -46,13 +49,20 @@ class GFBioSourceOperator : public GenericOperator {
 		void writeSemanticParameters(std::ostringstream& stream);
 
 	private:
-		std::string term;
-		std::string level;
+		std::vector<std::pair<std::string, std::string>> terms;
+		bool multiple_terms;
 		std::string dataSource;
 
 		std::vector<std::string> numeric_attributes;
 		std::vector<std::string> textual_attributes;
 
+		/**
+		 * resolve the taxa of all terms
+		 * @param taxon_terms is filled with the index of the matching term for each taxon if multiple terms are queried
+		 * @return postgres array of taxa
+		 */
+		std::string resolveTaxa(pqxx::connection &connection, std::map<std::string, size_t> &taxon_terms);
+
 		const std::set<std::string> gbif_columns {"gbifid", "datasetkey", "occurrenceid", "kingdom", "phylum", "class", "order", "family", "genus", "species", "infraspecificepithet", "taxonrank", "scientificname", "countrycode", "locality", "publishingorgkey", "decimallatitude", "decimallongitude", "coordinateuncertaintyinmeters", "coordinateprecision", "elevation", "elevationaccuracy", "depth", "depthaccuracy", "eventdate", "day", "month", "year", "taxonkey", "specieskey", "basisofrecord", "institutioncode", "collectioncode", "catalognumber", "recordnumber", "identifiedby", "license", "rightsholder", "recordedby", "typestatus", "establishmentmeans", "lastinterpreted", "mediatype", "issue"};
 };
 
@@ -60,12 +70,22 @@ class GFBioSourceOperator : public GenericOperator {
 GFBioSourceOperator::GFBioSourceOperator(int sourcecounts[], GenericOperator *sources[], Json::Value &params) : GenericOperator(sourcecounts, sources) {
 	assumeSources(0);
 
-	term = params.get("term", "").asString();
-	level = params.get("level", "").asString();
+	multiple_terms = params.isMember("terms");
+	if(multiple_terms) {
+		if(!params["terms"].isArray() || params["terms"].empty())
+			throw ArgumentException("GFBioSourceOperator: terms must be a non-empty array");
+
+		for(auto &term : params["terms"])
+			terms.emplace_back(term.get("term", "").asString(), term.get("level", "").asString());
+	} else {
+		terms.emplace_back(params.get("term", "").asString(), params.get("level", "").asString());
+	}
 	dataSource = params.get("dataSource", "").asString();
 
-	if(term.length() < 3)
-		throw ArgumentException("GFBioSourceOperator: scientificName must contain at least 3 characters");
+	for(auto &term : terms) {
+		if(term.first.length() < 3)
+			throw ArgumentException("GFBioSourceOperator: scientificName must contain at least 3 characters");
+	}
 
 	// attributes to be extracted
 	if(!params.isMember("columns") || !params["columns"].isObject())
@@ -91,8 +111,19 @@ REGISTER_OPERATOR(GFBioSourceOperator, "gfbio_source");
 
 void GFBioSourceOperator::writeSemanticParameters(std::ostringstream& stream) {
 	Json::Value json(Json::objectValue);
-	json["term"] = term;
-	json["level"] = level;
+	if(multiple_terms) {
+		Json::Value jsonTerms(Json::arrayValue);
+		for(auto &term : terms) {
+			Json::Value jsonTerm(Json::objectValue);
+			jsonTerm["term"] = term.first;
+			jsonTerm["level"] = term.second;
+			jsonTerms.append(jsonTerm);
+		}
+		json["terms"] = jsonTerms;
+	} else {
+		json["term"] = terms.front().first;
+		json["level"] = terms.front().second;
+	}
 	json["datasource"] = dataSource;
 
 	Json::Value columns(Json::objectValue);
@@ -114,12 +145,29 @@ void GFBioSourceOperator::writeSemanticParameters(std::ostringstream& stream) {
 
 #ifndef MAPPING_OPERATOR_STUBS
 
+std::string GFBioSourceOperator::resolveTaxa(pqxx::connection &connection, std::map<std::string, size_t> &taxon_terms) {
+	if(!multiple_terms)
+		return GFBioDataUtil::resolveTaxa(connection, terms.front().first, terms.front().second);
+
+	taxon_terms = GFBioDataUtil::resolveTaxaOfTerms(connection, terms);
+
+	std::stringstream taxa;
+	taxa << "{";
+	for(auto it = taxon_terms.begin(); it != taxon_terms.end(); ++it) {
+		if(it != taxon_terms.begin())
+			taxa << ",";
+		taxa << it->first;
+	}
+	taxa << "}";
+	return taxa.str();
+}
 
 void GFBioSourceOperator::getProvenance(ProvenanceCollection &pc) {
 	if(dataSource == "GBIF") {
 		pqxx::connection connection (Configuration::get<std::string>("operators.gfbiosource.dbcredentials"));
 
-		std::string taxa = GFBioDataUtil::resolveTaxa(connection, term, level);
+		std::map<std::string, size_t> taxon_terms;
+		std::string taxa = resolveTaxa(connection, taxon_terms);
 
 
 		connection.prepare("provenance", "SELECT DISTINCT key, citation, uri from gbif.gbif_lite_time join gbif.datasets ON (uid = key) WHERE taxon = ANY($1)");
@@ -141,10 +189,15 @@ std::unique_ptr<PointCollection> GFBioSourceOperator::getPointCollection(const Q
 	//TODO: reuse
 	pqxx::connection connection (Configuration::get<std::string>("operators.gfbiosource.dbcredentials"));
 
-	std::string taxa = GFBioDataUtil::resolveTaxa(connection, term, level);
+	std::map<std::string, size_t> taxon_terms;
+	std::string taxa = resolveTaxa(connection, taxon_terms);
 
 	//fetch occurrences
 	auto points = std::make_unique<PointCollection>(rect);
+	if(multiple_terms)
+		points->feature_attributes.addTextualAttribute("term", Unit::unknown());
+
+	std::string projection;
 	if(textual_attributes.size() > 0 || numeric_attributes.size() > 0) {
 		std::stringstream columns;
 
@@ -167,19 +220,46 @@ std::unique_ptr<PointCollection> GFBioSourceOperator::getPointCollection(const Q
 			columns << ", \"" << connection.esc(attribute) <<"\"";
 		}
 
-		std::string query =
-				"SELECT decimallongitude::double precision, decimallatitude::double precision, extract(epoch from eventdate)"
-						+ columns.str()
-						+ " from gbif.gbif WHERE taxonkey = ANY($1) AND ST_CONTAINS(ST_MakeEnvelope($2, $3, $4, $5, 4326), ST_SetSRID(ST_MakePoint(decimallongitude::double precision, decimallatitude::double precision),4326))";
+		// route the query to the narrowest projection of gbif.gbif that covers the requested columns
+		std::vector<std::string> requested_columns(numeric_attributes);
+		requested_columns.insert(requested_columns.end(), textual_attributes.begin(), textual_attributes.end());
+		std::sort(requested_columns.begin(), requested_columns.end());
+		requested_columns.erase(std::unique(requested_columns.begin(), requested_columns.end()), requested_columns.end());
 
-		connection.prepare("occurrences", query);
+		GFBioDataUtil::logGBIFColumnUsage(connection, requested_columns);
+		projection = GFBioDataUtil::findGBIFProjection(connection, requested_columns);
+
+		connection.prepare("occurrences", "SELECT decimallongitude::double precision, decimallatitude::double precision, extract(epoch from eventdate), taxonkey::text AS matched_taxon"
+					+ columns.str()
+					+ " from gbif.gbif WHERE taxonkey = ANY($1) AND ST_CONTAINS(ST_MakeEnvelope($2, $3, $4, $5, 4326), ST_SetSRID(ST_MakePoint(decimallongitude::double precision, decimallatitude::double precision),4326))");
+
+		if(!projection.empty()) {
+			connection.prepare("occurrencesOfProjection", "SELECT decimallongitude::double precision, decimallatitude::double precision, extract(epoch from eventdate), taxonkey::text AS matched_taxon"
+						+ columns.str()
+						+ " from " + projection + " WHERE taxonkey = ANY($1) AND ST_CONTAINS(ST_MakeEnvelope($2, $3, $4, $5, 4326), geom)");
+		}
 	}
 	else
-		connection.prepare("occurrences", "SELECT ST_X(geom) x, ST_Y(geom) y, extract(epoch from event_date) FROM gbif.gbif_lite_time WHERE taxon = ANY($1) AND ST_CONTAINS(ST_MakeEnvelope($2, $3, $4, $5, 4326), geom)");
-
-	pqxx::work work(connection);
-	pqxx::result result = work.prepared("occurrences")(taxa)(rect.x1)(rect.y1)(rect.x2)(rect.y2).exec();
-    work.commit();
+		connection.prepare("occurrences", "SELECT ST_X(geom) x, ST_Y(geom) y, extract(epoch from event_date), taxon::text AS matched_taxon FROM gbif.gbif_lite_time WHERE taxon = ANY($1) AND ST_CONTAINS(ST_MakeEnvelope($2, $3, $4, $5, 4326), geom)");
+
+	pqxx::result result;
+	bool fetched = false;
+	if(!projection.empty()) {
+		// the cached catalog may still contain a projection that a refresh has dropped since
+		try {
+			pqxx::work work(connection);
+			result = work.prepared("occurrencesOfProjection")(taxa)(rect.x1)(rect.y1)(rect.x2)(rect.y2).exec();
+			work.commit();
+			fetched = true;
+		} catch (const pqxx::undefined_table &) {
+			GFBioDataUtil::invalidateGBIFProjections();
+		}
+	}
+	if(!fetched) {
+		pqxx::work work(connection);
+		result = work.prepared("occurrences")(taxa)(rect.x1)(rect.y1)(rect.x2)(rect.y2).exec();
+		work.commit();
+	}
 
     //build feature collection
     //TODO: use cursor
@@ -197,6 +277,11 @@ std::unique_ptr<PointCollection> GFBioSourceOperator::getPointCollection(const Q
 //
 //    	points->time.push_back(TimeInterval(t, rect.end_of_time()));
 
+    	if(multiple_terms) {
+    		auto term = taxon_terms.find(row["matched_taxon"].as<std::string>());
+    		points->feature_attributes.textual("term").set(i, term != taxon_terms.end() ? terms[term->second].first : "");
+    	}
+
     	// attributes
     	for(auto &attribute : numeric_attributes) {
     		auto value = row[attribute];
@@ -232,7 +317,8 @@ std::unique_ptr<PolygonCollection> GFBioSourceOperator::getPolygonCollection(con
 	//TODO: reuse
 	pqxx::connection connection (Configuration::get<std::string>("operators.gfbiosource.dbcredentials"));
 
-	std::string taxa = GFBioDataUtil::resolveTaxaNames(connection, term, level);
+	std::map<std::string, size_t> taxon_terms;
+	std::string taxa = GFBioDataUtil::resolveNamesOfTaxa(connection, resolveTaxa(connection, taxon_terms));
 
 
 	connection.prepare("occurrences", "SELECT ST_AsEWKT(ST_Collect(geom)) FROM iucn.expert_ranges_all WHERE lower(binomial) = ANY ($1)");
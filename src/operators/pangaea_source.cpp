@@ -1,5 +1,6 @@
 #include "operators/operator.h"
 #include "datatypes/pointcollection.h"
+#include "datatypes/polygoncollection.h"
 
 #include "util/curl.h"
 #include "util/configuration.h"
@@ -7,21 +8,88 @@
 #include "util/timeparser.h"
 #include "util/csvparser.h"
 #include "util/pangaeaapi.h"
+#include "util/curlstream.h"
+#include "util/pangaeacache.h"
+#include "util/pangaeatable.h"
 
 
 #include <vector>
+#include <set>
+#include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <future>
 #include <limits>
 #include <sstream>
 #include <iostream>
 #include <json/json.h>
 #include <regex>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
 
 
+/**
+ * Stream buffer that serves a prefix string followed by the content of another stream buffer.
+ * It stops after `limit` bytes of the other stream buffer, if the limit is not 0.
+ */
+class PrefixedStreamBuffer : public std::streambuf {
+	public:
+		PrefixedStreamBuffer(std::string prefix, std::streambuf *source, size_t limit = 0)
+				: prefix(std::move(prefix)), source(source), limit(limit), consumed(0), limitExceeded(false) {
+			setg(&this->prefix[0], &this->prefix[0], &this->prefix[0] + this->prefix.size());
+		}
+
+		/**
+		 * throw if the source was cut off at the limit
+		 */
+		void checkLimit() const {
+			if(limitExceeded)
+				throw OperatorException(concat("PangaeaSourceOperator: the data set is larger than ", limit / (1024 * 1024),
+											   " MiB (pangaea.memory.max), request a smaller area"));
+		}
+
+	protected:
+		int_type underflow() override {
+			if(gptr() < egptr())
+				return traits_type::to_int_type(*gptr());
+
+			if(limitExceeded)
+				return traits_type::eof();
+
+			std::streamsize size = source->sgetn(chunk, sizeof(chunk));
+			if(size <= 0)
+				return traits_type::eof();
+
+			// exceptions would be swallowed by the reading istream, so the limit is reported as end of stream
+			consumed += size;
+			if(limit > 0 && consumed > limit) {
+				limitExceeded = true;
+				return traits_type::eof();
+			}
+
+			setg(chunk, chunk, chunk + size);
+			return traits_type::to_int_type(*gptr());
+		}
+
+	private:
+		std::string prefix;
+		std::streambuf *source;
+		size_t limit;
+		size_t consumed;
+		bool limitExceeded;
+		char chunk[64 * 1024];
+};
+
 /**
  * Operator that gets points from pangaea
  *
  * Parameters:
- * - dataLink: the link to the tab separated data file
+ * - doi: the doi of the data set
+ * - dois: alternatively, a list of dois of data sets with compatible parameters. Their points are
+ *   loaded concurrently and merged into one collection with an additional `doi` attribute.
  * - other csv columns
  */
 class PangaeaSourceOperator : public GenericOperator {
@@ -57,8 +125,20 @@ class PangaeaSourceOperator : public GenericOperator {
 		virtual ~PangaeaSourceOperator(){};
 
 	private:
+		/**
+		 * the selected rows of a data set, together with the file or table that holds its columns
+		 */
+		class DataSetRows {
+			public:
+				std::string doi;
+				std::unique_ptr<PangaeaColumnarFile> columnarFile;
+				std::unique_ptr<PangaeaTable> table;
+				std::vector<PangaeaColumn> columns;
+				std::vector<size_t> selected;
+		};
+
 		std::string doi;
-		cURL curl;
+		std::vector<std::string> dois;
 
 		std::vector<std::string> columns_textual;
 		std::vector<std::string> columns_numeric;
@@ -66,6 +146,9 @@ class PangaeaSourceOperator : public GenericOperator {
 		std::string column_x;
 		std::string column_y;
 
+		std::string geometry;
+		std::string time;
+
 		std::string citation;
 		std::string license;
 		std::string uri;
@@ -74,7 +157,85 @@ class PangaeaSourceOperator : public GenericOperator {
 
 
 #ifndef MAPPING_OPERATOR_STUBS
-		void getStringFromServer(std::stringstream& data);
+		/**
+		 * open the textfile of the data set, either from the cache or as a download stream
+		 */
+		std::unique_ptr<std::istream> openTextfile(const std::string &dataSetDOI);
+
+		/**
+		 * write the already received part and the rest of a textfile into an unlinked temporary file, so that
+		 * the connection is not held open while parsing and the data is read from disk instead of the network
+		 */
+		std::unique_ptr<std::istream> spillTextfile(cURLInputStream &download, const std::string &received);
+
+		/**
+		 * open the textfile in the background and skip its header, so that the download overlaps
+		 * with fetching the metadata
+		 */
+		std::future<std::unique_ptr<std::istream>> prefetchTextfile(const std::string &dataSetDOI);
+
+		/**
+		 * throw if reading the textfile failed
+		 */
+		void checkTextfile(std::istream &data);
+
+		/**
+		 * check if the query can be answered from a columnar representation of the data set
+		 * instead of parsing it as csv
+		 */
+		bool supportsColumnarAccess(const PangaeaAPI::MetaData &metaData);
+
+		/**
+		 * @return the names of all columns the query needs
+		 */
+		std::set<std::string> getRequiredColumns();
+
+		/**
+		 * select the rows of a columnar file inside the query rectangle, using its spatial index if possible
+		 */
+		std::vector<size_t> selectRows(const PangaeaColumnarFile &columnarFile, const QueryRectangle &rect);
+
+		/**
+		 * select the rows inside the query rectangle by checking every row
+		 */
+		std::vector<size_t> scanRows(const std::vector<PangaeaColumn> &columns, size_t rows, const QueryRectangle &rect);
+
+		/**
+		 * load the rows of a data set inside the query rectangle from its columnar file or its textfile
+		 */
+		DataSetRows loadRows(const std::string &dataSetDOI, const PangaeaAPI::MetaData &metaData,
+							 std::future<std::unique_ptr<std::istream>> &textfile, const QueryRectangle &rect);
+
+		/**
+		 * call `task(i)` for the index of every data set, using at most `pangaea.downloads.concurrency` threads.
+		 * The first exception of a task is rethrown after no further data sets are handed out.
+		 */
+		void forEachDataSet(const std::function<void(size_t)> &task);
+
+		/**
+		 * load the rows of all data sets concurrently, using at most `pangaea.downloads.concurrency` threads
+		 */
+		std::vector<DataSetRows> loadRowsOfDataSets(const QueryRectangle &rect);
+
+		std::unique_ptr<PointCollection> createPointCollection(const std::vector<DataSetRows> &dataSets, const QueryRectangle &rect);
+
+		/**
+		 * check if the data set has no coordinate columns and the query can use the spatial coverage
+		 * of the data set as geometry of every row
+		 */
+		bool supportsCoverageGeometry(const PangaeaAPI::MetaData &metaData, PangaeaAPI::MetaData::SpatialCoverageType type);
+
+		/**
+		 * parse the attribute columns of the textfile, selecting all rows iff the spatial coverage
+		 * intersects the query rectangle
+		 */
+		DataSetRows parseAttributes(std::istream &data, const PangaeaAPI::MetaData &metaData, const QueryRectangle &rect);
+
+		/**
+		 * add the requested numeric and textual attributes of the selected rows of all data sets, in order.
+		 * With more than one data set, the doi of each row is added as well.
+		 */
+		void addAttributes(SimpleFeatureCollection &collection, const std::vector<DataSetRows> &dataSets);
 
 		/**
 		 * check if lat/lon parameters exist
@@ -82,8 +243,6 @@ class PangaeaSourceOperator : public GenericOperator {
 		bool hasGeoReference(const std::vector<PangaeaAPI::Parameter> parameters);
 
 		std::string buildCSVHeader(const std::vector<PangaeaAPI::Parameter> parameters);
-
-		std::string extractCSV(std::stringstream &data, PangaeaAPI::MetaData &metaData);
 #endif
 };
 REGISTER_OPERATOR(PangaeaSourceOperator, "pangaea_source");
@@ -92,13 +251,36 @@ REGISTER_OPERATOR(PangaeaSourceOperator, "pangaea_source");
 PangaeaSourceOperator::PangaeaSourceOperator(int sourcecounts[], GenericOperator *sources[], Json::Value &params) : GenericOperator(sourcecounts, sources) {
 	assumeSources(0);
 	doi = params.get("doi", "").asString();
+	for(auto &dataSetDOI : params.get("dois", Json::Value(Json::arrayValue)))
+		dois.push_back(dataSetDOI.asString());
+	if(dois.empty())
+		dois.push_back(doi);
+	else
+		doi = dois.front();
 
 	csvUtil = std::make_unique<CSVSourceUtil>(params);
+
+	geometry = params.get("geometry", "xy").asString();
+	time = params.get("time", "none").asString();
+
+	Json::Value columns = params.get("columns", Json::Value(Json::objectValue));
+	column_x = columns.get("x", "").asString();
+	column_y = columns.get("y", "").asString();
+	for(auto &column : columns.get("numeric", Json::Value(Json::arrayValue)))
+		columns_numeric.push_back(column.asString());
+	for(auto &column : columns.get("textual", Json::Value(Json::arrayValue)))
+		columns_textual.push_back(column.asString());
 }
 
 void PangaeaSourceOperator::writeSemanticParameters(std::ostringstream& stream) {
 	Json::Value params = csvUtil->getParameters();
-	params["doi"] = doi;
+	if(dois.size() > 1) {
+		params["dois"] = Json::Value(Json::arrayValue);
+		for(auto &dataSetDOI : dois)
+			params["dois"].append(dataSetDOI);
+	} else {
+		params["doi"] = doi;
+	}
 
 	stream << params;
 }
@@ -136,78 +318,418 @@ std::string PangaeaSourceOperator::buildCSVHeader(const std::vector<PangaeaAPI::
 	return ss.str();
 }
 
-std::string PangaeaSourceOperator::extractCSV(std::stringstream &data, PangaeaAPI::MetaData &metaData) {
-	// skip initial comment
-	std::string str = data.str();
-	size_t offset = str.find("*/\n") + 3;
-	// skip header column
-	// TODO handle \n in column headers
-	offset = str.find("\n", offset) + 1;
+bool PangaeaSourceOperator::supportsColumnarAccess(const PangaeaAPI::MetaData &metaData) {
+	if(time != "none" || geometry != "xy")
+		return false;
+
+	bool hasX = false;
+	bool hasY = false;
+	for(auto &parameter : metaData.parameters) {
+		hasX = hasX || parameter.name == column_x;
+		hasY = hasY || parameter.name == column_y;
+	}
+
+	return hasX && hasY;
+}
 
-	std::string dataString = buildCSVHeader(metaData.parameters);
-	dataString += data.str().substr(offset);
+std::vector<size_t> PangaeaSourceOperator::selectRows(const PangaeaColumnarFile &columnarFile, const QueryRectangle &rect) {
+	if(columnarFile.hasSpatialIndex(column_x, column_y))
+		return columnarFile.queryRows(rect.x1, rect.y1, rect.x2, rect.y2);
+	if(columnarFile.hasSpatialIndex(column_y, column_x))
+		return columnarFile.queryRows(rect.y1, rect.x1, rect.y2, rect.x2);
 
-	return dataString;
+	return scanRows(columnarFile.getColumns(), columnarFile.getRowCount(), rect);
+}
+
+std::set<std::string> PangaeaSourceOperator::getRequiredColumns() {
+	std::set<std::string> required{column_x, column_y};
+	required.insert(columns_numeric.begin(), columns_numeric.end());
+	required.insert(columns_textual.begin(), columns_textual.end());
+	return required;
+}
+
+std::vector<size_t> PangaeaSourceOperator::scanRows(const std::vector<PangaeaColumn> &columns, size_t rows, const QueryRectangle &rect) {
+	const PangaeaColumn *x = nullptr;
+	const PangaeaColumn *y = nullptr;
+	for(auto &column : columns) {
+		if(column.name == column_x)
+			x = &column;
+		if(column.name == column_y)
+			y = &column;
+	}
+	if(x == nullptr || y == nullptr)
+		throw ArgumentException("PangaeaSourceOperator: coordinate columns do not exist");
+
+	std::vector<size_t> selected;
+	for(size_t row = 0; row < rows; ++row) {
+		double px = x->getNumeric(row);
+		double py = y->getNumeric(row);
+		if(std::isfinite(px) && std::isfinite(py) && px >= rect.x1 && px <= rect.x2 && py >= rect.y1 && py <= rect.y2)
+			selected.push_back(row);
+	}
+	return selected;
+}
+
+static const PangaeaColumn &findColumn(const std::vector<PangaeaColumn> &columns, const std::string &name) {
+	for(auto &column : columns) {
+		if(column.name == name)
+			return column;
+	}
+	throw ArgumentException(concat("PangaeaSourceOperator: column ", name, " does not exist"));
+}
+
+std::unique_ptr<PointCollection> PangaeaSourceOperator::createPointCollection(const std::vector<DataSetRows> &dataSets, const QueryRectangle &rect) {
+	auto points = std::make_unique<PointCollection>(rect);
+
+	for(auto &dataSet : dataSets) {
+		const PangaeaColumn &x = findColumn(dataSet.columns, column_x);
+		const PangaeaColumn &y = findColumn(dataSet.columns, column_y);
+		for(size_t row : dataSet.selected)
+			points->addSinglePointFeature(Coordinate(x.getNumeric(row), y.getNumeric(row)));
+	}
+
+	addAttributes(*points, dataSets);
+
+	return points;
+}
+
+void PangaeaSourceOperator::addAttributes(SimpleFeatureCollection &collection, const std::vector<DataSetRows> &dataSets) {
+	size_t features = 0;
+	for(auto &dataSet : dataSets)
+		features += dataSet.selected.size();
+
+	for(auto &name : columns_numeric) {
+		auto &attribute = collection.feature_attributes.addNumericAttribute(name, Unit::unknown());
+		attribute.reserve(features);
+		size_t feature = 0;
+		for(auto &dataSet : dataSets) {
+			const PangaeaColumn &column = findColumn(dataSet.columns, name);
+			for(size_t row : dataSet.selected)
+				attribute.set(feature++, column.getNumeric(row));
+		}
+	}
+
+	for(auto &name : columns_textual) {
+		auto &attribute = collection.feature_attributes.addTextualAttribute(name, Unit::unknown());
+		attribute.reserve(features);
+		size_t feature = 0;
+		for(auto &dataSet : dataSets) {
+			const PangaeaColumn &column = findColumn(dataSet.columns, name);
+			for(size_t row : dataSet.selected)
+				attribute.set(feature++, column.getText(row));
+		}
+	}
+
+	if(dataSets.size() > 1) {
+		auto &attribute = collection.feature_attributes.addTextualAttribute("doi", Unit::unknown());
+		attribute.reserve(features);
+		size_t feature = 0;
+		for(auto &dataSet : dataSets) {
+			for(size_t i = 0; i < dataSet.selected.size(); ++i)
+				attribute.set(feature++, dataSet.doi);
+		}
+	}
+}
+
+bool PangaeaSourceOperator::supportsCoverageGeometry(const PangaeaAPI::MetaData &metaData, PangaeaAPI::MetaData::SpatialCoverageType type) {
+	return time == "none" && geometry == "wkt" && metaData.spatialCoverageType == type && !hasGeoReference(metaData.parameters);
+}
+
+PangaeaSourceOperator::DataSetRows PangaeaSourceOperator::parseAttributes(std::istream &data, const PangaeaAPI::MetaData &metaData,
+																		  const QueryRectangle &rect) {
+	std::set<std::string> required(columns_numeric.begin(), columns_numeric.end());
+	required.insert(columns_textual.begin(), columns_textual.end());
+
+	DataSetRows dataSet;
+	dataSet.doi = doi;
+	dataSet.table = std::make_unique<PangaeaTable>(metaData.parameters, required);
+	dataSet.table->parse(data);
+	checkTextfile(data);
+	dataSet.columns = dataSet.table->getColumns();
+
+	if(metaData.spatialCoverageX1 <= rect.x2 && metaData.spatialCoverageX2 >= rect.x1
+	   && metaData.spatialCoverageY1 <= rect.y2 && metaData.spatialCoverageY2 >= rect.y1) {
+		dataSet.selected.resize(dataSet.table->getRowCount());
+		for(size_t row = 0; row < dataSet.selected.size(); ++row)
+			dataSet.selected[row] = row;
+	}
+
+	return dataSet;
+}
+
+std::unique_ptr<std::istream> PangaeaSourceOperator::openTextfile(const std::string &dataSetDOI) {
+	if(PangaeaCache::isEnabled()) {
+		std::string path = PangaeaCache::getTextfile(dataSetDOI);
+		auto file = std::make_unique<std::ifstream>(path, std::ios::binary);
+		if(!*file)
+			throw OperatorException(concat("PangaeaSourceOperator: could not open cached data set ", path));
+		return std::move(file);
+	}
+
+	auto download = std::make_unique<cURLInputStream>(PangaeaAPI::getDataUrl(dataSetDOI));
+
+	// wait for the response to learn its size
+	download->peek();
+	const long long threshold = Configuration::get<long long>("pangaea.spill.threshold", 256) * 1024 * 1024;
+	const long long contentLength = download->getContentLength();
+	if(contentLength > threshold)
+		return spillTextfile(*download, "");
+	if(contentLength >= 0)
+		return std::move(download);
+
+	// without an announced size, the download is received into memory until it passes the threshold
+	std::string received;
+	std::vector<char> buffer(1 << 20);
+	while(static_cast<long long>(received.size()) <= threshold
+		  && (download->read(buffer.data(), buffer.size()) || download->gcount() > 0))
+		received.append(buffer.data(), download->gcount());
+
+	if(static_cast<long long>(received.size()) > threshold)
+		return spillTextfile(*download, received);
+
+	download->checkTransfer();
+	return std::make_unique<std::istringstream>(std::move(received));
+}
+
+std::unique_ptr<std::istream> PangaeaSourceOperator::spillTextfile(cURLInputStream &download, const std::string &received) {
+	std::string path = concat(Configuration::get<std::string>("pangaea.spill.directory", "/tmp"), "/pangaea_XXXXXX");
+	int fd = mkstemp(&path[0]);
+	if(fd < 0)
+		throw OperatorException("PangaeaSourceOperator: could not create a temporary file for a large download");
+	close(fd);
+
+	// the file is removed if the download fails at any point
+	try {
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(received.data(), received.size());
+
+		std::vector<char> buffer(1 << 20);
+		while(download.read(buffer.data(), buffer.size()) || download.gcount() > 0)
+			file.write(buffer.data(), download.gcount());
+
+		if(!file)
+			throw OperatorException(concat("PangaeaSourceOperator: could not write the download to ", path));
+		file.close();
+
+		download.checkTransfer();
+	} catch (...) {
+		std::remove(path.c_str());
+		throw;
+	}
+
+	auto file = std::make_unique<std::ifstream>(path, std::ios::binary);
+	// the open stream keeps the unlinked file readable
+	std::remove(path.c_str());
+	if(!*file)
+		throw OperatorException(concat("PangaeaSourceOperator: could not read the download from ", path));
+
+	return std::move(file);
+}
+
+std::future<std::unique_ptr<std::istream>> PangaeaSourceOperator::prefetchTextfile(const std::string &dataSetDOI) {
+	return std::async(std::launch::async, [this, dataSetDOI]() {
+		auto data = openTextfile(dataSetDOI);
+		PangaeaTable::skipTextfileHeader(*data);
+		return data;
+	});
+}
+
+void PangaeaSourceOperator::checkTextfile(std::istream &data) {
+	if(auto download = dynamic_cast<cURLInputStream *>(&data)) {
+		download->checkTransfer();
+	} else if(data.bad()) {
+		throw OperatorException("PangaeaSourceOperator: could not read cached data set");
+	}
+}
+
+PangaeaSourceOperator::DataSetRows PangaeaSourceOperator::loadRows(const std::string &dataSetDOI, const PangaeaAPI::MetaData &metaData,
+																  std::future<std::unique_ptr<std::istream>> &textfile, const QueryRectangle &rect) {
+	DataSetRows dataSet;
+	dataSet.doi = dataSetDOI;
+
+	auto data = textfile.get();
+
+	// the prefetch brought the cached textfile up to date
+	std::string columnarPath = PangaeaCache::isEnabled() ? PangaeaCache::getColumnarFile(dataSetDOI, metaData) : "";
+	if(!columnarPath.empty()) {
+		dataSet.columnarFile = std::make_unique<PangaeaColumnarFile>(columnarPath);
+		dataSet.columns = dataSet.columnarFile->getColumns();
+		dataSet.selected = selectRows(*dataSet.columnarFile, rect);
+		return dataSet;
+	}
+
+	// parse only the required columns of the textfile
+	dataSet.table = std::make_unique<PangaeaTable>(metaData.parameters, getRequiredColumns());
+	dataSet.table->parse(*data);
+	checkTextfile(*data);
+
+	dataSet.columns = dataSet.table->getColumns();
+	dataSet.selected = scanRows(dataSet.columns, dataSet.table->getRowCount(), rect);
+	return dataSet;
+}
+
+void PangaeaSourceOperator::forEachDataSet(const std::function<void(size_t)> &task) {
+	std::atomic<size_t> next(0);
+
+	auto worker = [this, &task, &next]() {
+		for(size_t i = next++; i < dois.size(); i = next++)
+			task(i);
+	};
+
+	size_t concurrency = std::max<size_t>(1, std::min(dois.size(), Configuration::get<size_t>("pangaea.downloads.concurrency", 8)));
+	std::vector<std::future<void>> workers;
+	for(size_t i = 0; i < concurrency; ++i)
+		workers.push_back(std::async(std::launch::async, worker));
+
+	std::exception_ptr exception;
+	for(auto &future : workers) {
+		try {
+			future.get();
+		} catch (...) {
+			// stop handing out data sets before waiting for the others
+			next = dois.size();
+			if(!exception)
+				exception = std::current_exception();
+		}
+	}
+
+	if(exception)
+		std::rethrow_exception(exception);
+}
+
+std::vector<PangaeaSourceOperator::DataSetRows> PangaeaSourceOperator::loadRowsOfDataSets(const QueryRectangle &rect) {
+	std::vector<DataSetRows> dataSets(dois.size());
+
+	forEachDataSet([this, &dataSets, &rect](size_t i) {
+		auto textfile = prefetchTextfile(dois[i]);
+		auto sharedMetaData = PangaeaAPI::getMetaData(dois[i]);
+		const PangaeaAPI::MetaData &metaData = *sharedMetaData;
+		if(!supportsColumnarAccess(metaData))
+			throw ArgumentException(concat("PangaeaSourceOperator: data set ", dois[i], " does not provide the columns ",
+										   column_x, " and ", column_y, " or the query needs time or wkt geometry"));
+
+		dataSets[i] = loadRows(dois[i], metaData, textfile, rect);
+	});
+
+	return dataSets;
 }
 
 std::unique_ptr<PointCollection> PangaeaSourceOperator::getPointCollection(const QueryRectangle &rect, const QueryTools &tools){
-	PangaeaAPI::MetaData metaData = PangaeaAPI::getMetaData(doi);
+	if(dois.size() > 1)
+		return createPointCollection(loadRowsOfDataSets(rect), rect);
 
-	std::stringstream data;
-	getStringFromServer(data);
+	auto textfile = prefetchTextfile(doi);
+	auto sharedMetaData = PangaeaAPI::getMetaData(doi);
+	const PangaeaAPI::MetaData &metaData = *sharedMetaData;
 
-	std::string dataString = extractCSV(data, metaData);
+	std::vector<DataSetRows> dataSets;
+	if(supportsColumnarAccess(metaData)) {
+		dataSets.push_back(loadRows(doi, metaData, textfile, rect));
+		return createPointCollection(dataSets, rect);
+	}
+
+	auto data = textfile.get();
+
+	if(supportsCoverageGeometry(metaData, PangaeaAPI::MetaData::SpatialCoverageType::POINT)) {
+		dataSets.push_back(parseAttributes(*data, metaData, rect));
+
+		// every row is located at the coverage point
+		auto points = std::make_unique<PointCollection>(rect);
+		const Coordinate coverage(metaData.spatialCoverageX1, metaData.spatialCoverageY1);
+		for(size_t i = 0; i < dataSets[0].selected.size(); ++i)
+			points->addSinglePointFeature(coverage);
+
+		addAttributes(*points, dataSets);
+		return points;
+	}
 
 	if(!hasGeoReference(metaData.parameters)) {
 		csvUtil->default_x = metaData.spatialCoverageWKT;
 	}
 
-	std::istringstream iss(dataString);
-	auto points = csvUtil->getPointCollection(iss, rect);
+	// the parsed collection is about as large as the text, so the text is limited like the parsed columns
+	PrefixedStreamBuffer csvBuffer(buildCSVHeader(metaData.parameters), data->rdbuf(),
+								   Configuration::get<size_t>("pangaea.memory.max", 2048) * 1024 * 1024);
+	std::istream csv(&csvBuffer);
+	auto points = csvUtil->getPointCollection(csv, rect);
+	csvBuffer.checkLimit();
+
+	checkTextfile(*data);
 
 	return points;
 }
 
 std::unique_ptr<PolygonCollection> PangaeaSourceOperator::getPolygonCollection(const QueryRectangle &rect, const QueryTools &tools){
-	PangaeaAPI::MetaData metaData = PangaeaAPI::getMetaData(doi);
-
-	std::stringstream data;
-	getStringFromServer(data);
+	if(dois.size() > 1)
+		throw ArgumentException("PangaeaSourceOperator: multiple data sets are only supported for points");
+
+	auto textfile = prefetchTextfile(doi);
+	auto sharedMetaData = PangaeaAPI::getMetaData(doi);
+	const PangaeaAPI::MetaData &metaData = *sharedMetaData;
+
+	auto data = textfile.get();
+
+	if(supportsCoverageGeometry(metaData, PangaeaAPI::MetaData::SpatialCoverageType::BOX)) {
+		std::vector<DataSetRows> dataSets;
+		dataSets.push_back(parseAttributes(*data, metaData, rect));
+
+		// every row covers the coverage box, build its ring from the coordinates instead of parsing wkt per row
+		auto polygons = std::make_unique<PolygonCollection>(rect);
+		const double x1 = metaData.spatialCoverageX1, y1 = metaData.spatialCoverageY1;
+		const double x2 = metaData.spatialCoverageX2, y2 = metaData.spatialCoverageY2;
+		for(size_t i = 0; i < dataSets[0].selected.size(); ++i) {
+			polygons->addCoordinate(x1, y1);
+			polygons->addCoordinate(x1, y2);
+			polygons->addCoordinate(x2, y2);
+			polygons->addCoordinate(x2, y1);
+			polygons->addCoordinate(x1, y1);
+			polygons->finishRing();
+			polygons->finishPolygon();
+			polygons->finishFeature();
+		}
 
-	std::string dataString = extractCSV(data, metaData);
+		addAttributes(*polygons, dataSets);
+		return polygons;
+	}
 
 	if(!hasGeoReference(metaData.parameters)) {
 		csvUtil->default_x = metaData.spatialCoverageWKT;
-		fprintf(stderr, ">> %s", metaData.spatialCoverageWKT.c_str());
 	}
 
-	std::istringstream iss(dataString);
-	auto polygons = csvUtil->getPolygonCollection(iss, rect);
-
-	return polygons;
-}
+	// the parsed collection is about as large as the text, so the text is limited like the parsed columns
+	PrefixedStreamBuffer csvBuffer(buildCSVHeader(metaData.parameters), data->rdbuf(),
+								   Configuration::get<size_t>("pangaea.memory.max", 2048) * 1024 * 1024);
+	std::istream csv(&csvBuffer);
+	auto polygons = csvUtil->getPolygonCollection(csv, rect);
+	csvBuffer.checkLimit();
 
-void PangaeaSourceOperator::getStringFromServer(std::stringstream& data) {
-	curl.setOpt(CURLOPT_PROXY, Configuration::get<std::string>("proxy", "").c_str());
-	curl.setOpt(CURLOPT_URL, concat("https://doi.pangaea.de/", doi, "?format=textfile").c_str());
-	curl.setOpt(CURLOPT_WRITEFUNCTION, cURL::defaultWriteFunction);
-	curl.setOpt(CURLOPT_WRITEDATA, &data);
+	checkTextfile(*data);
 
-	curl.perform();
+	return polygons;
 }
 
 void PangaeaSourceOperator::getProvenance(ProvenanceCollection &pc) {
-	Provenance provenance;
+	std::vector<std::string> citations(dois.size());
+	std::vector<std::shared_ptr<const PangaeaAPI::MetaData>> metaData(dois.size());
 
-	provenance.citation = PangaeaAPI::getCitation(doi);
+	forEachDataSet([this, &citations, &metaData](size_t i) {
+		// both requests of a data set run at the same time, the citation future is joined even if the metadata fails
+		auto citation = std::async(std::launch::async, &PangaeaAPI::getCitation, std::cref(dois[i]));
+		metaData[i] = PangaeaAPI::getMetaData(dois[i]);
+		citations[i] = citation.get();
+	});
 
-	PangaeaAPI::MetaData metaData = PangaeaAPI::getMetaData(doi);
+	for(size_t i = 0; i < dois.size(); ++i) {
+		Provenance provenance;
 
-	provenance.license = metaData.license;
-	provenance.uri = metaData.url;
+		provenance.citation = citations[i];
 
-	provenance.local_identifier =  "data." + getType();
+		provenance.license = metaData[i]->license;
+		provenance.uri = metaData[i]->url;
 
-	pc.add(provenance);
+		provenance.local_identifier =  "data." + getType();
+
+		pc.add(provenance);
+	}
 }
 #endif
@@ -4,6 +4,11 @@
 #include "datatypes/polygoncollection.h"
 #include "operators/operator.h"
 #include <json/json.h>
+#include <map>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
 #include "util/terminology.h"
 
 /**
@@ -20,6 +25,8 @@
  *  - on_not_resolvable: if no label for the term was found, what to insert into resolved attribute.
  *      - "EMPTY" inserts an empty string
  *      - "KEEP" inserts the original term
+ *  - mappings: optional array of objects with the parameters above, to resolve several attributes or
+ *              terminologies in one pass. Parameters missing in a mapping are taken from the operator.
  */
 
 class TerminologyResolver : public GenericOperator {
@@ -35,145 +42,232 @@ protected:
     void writeSemanticParameters(std::ostringstream& stream) override;
 
 private:
-    std::string attribute_name;
-    std::string terminology;
-    std::string key;
-    std::string resolved_attribute;
-    std::string match_type;
-    bool first_hit;
-    HandleNotResolvable on_not_resolvable;
+    /**
+     * an attribute that is resolved with a terminology into a new attribute
+     */
+    struct Mapping {
+        std::string attribute_name;
+        std::string terminology;
+        std::string key;
+        std::string resolved_attribute;
+        std::string match_type;
+        bool first_hit;
+        HandleNotResolvable on_not_resolvable;
+    };
+
+    static Mapping parseMapping(const Json::Value &params, const Json::Value &defaults);
+
+    static Json::Value toJson(const Mapping &mapping);
+
+    /**
+     * add the resolved attributes to a collection. Each source attribute is scanned once and each of its distinct
+     * names is resolved once per mapping. The requests of all mappings run at the same time and the results are
+     * assigned to the features by their index in the dictionary of distinct names.
+     */
+    void resolveAttributes(SimpleFeatureCollection &collection);
+
+    std::vector<Mapping> mappings;
 
 };
 
 TerminologyResolver::TerminologyResolver(int *sourcecounts, GenericOperator **sources, Json::Value &params)
         : GenericOperator(sourcecounts, sources)
 {
-    terminology         = params.get("terminology", "").asString();
-    if(terminology.find(',') != std::string::npos){
-        throw ArgumentException("TerminologyResolver: Only one terminology should be requested, not multiple concatenated by ','.");
+    const Json::Value mappings_json = params.get("mappings", Json::Value(Json::nullValue));
+    if(mappings_json.isNull()) {
+        mappings.push_back(parseMapping(params, Json::Value(Json::objectValue)));
+    } else {
+        if(!mappings_json.isArray() || mappings_json.empty())
+            throw ArgumentException("Terminology Resolver: mappings must be a non-empty array.");
+        for(auto &mapping_json : mappings_json) {
+            if(!mapping_json.isObject())
+                throw ArgumentException("Terminology Resolver: each mapping must be an object.");
+            mappings.push_back(parseMapping(mapping_json, params));
+        }
     }
-    attribute_name      = params.get("attribute_name", "").asString();
-    key                 = params.get("key", "label").asString();
-    resolved_attribute  = params.get("resolved_attribute", "").asString();
-    if(resolved_attribute == attribute_name){
-        throw OperatorException("Terminology Resolver: name of resolved attribute has to be different from existing attribute.");
+
+    // a mapping must neither overwrite a source attribute nor the result of another mapping
+    std::set<std::string> resolved_attributes;
+    for(auto &mapping : mappings) {
+        if(!resolved_attributes.insert(mapping.resolved_attribute).second)
+            throw OperatorException("Terminology Resolver: resolved attribute " + mapping.resolved_attribute + " is used by multiple mappings.");
+    }
+    for(auto &mapping : mappings) {
+        if(resolved_attributes.count(mapping.attribute_name) > 0){
+            throw OperatorException("Terminology Resolver: name of resolved attribute has to be different from existing attribute.");
+        }
+    }
+}
+
+TerminologyResolver::Mapping TerminologyResolver::parseMapping(const Json::Value &params, const Json::Value &defaults) {
+    Mapping mapping;
+
+    mapping.terminology         = params.get("terminology", defaults.get("terminology", "")).asString();
+    if(mapping.terminology.find(',') != std::string::npos){
+        throw ArgumentException("TerminologyResolver: Only one terminology should be requested, not multiple concatenated by ','. Use mappings instead.");
     }
+    mapping.attribute_name      = params.get("attribute_name", defaults.get("attribute_name", "")).asString();
+    mapping.key                 = params.get("key", defaults.get("key", "label")).asString();
+    mapping.resolved_attribute  = params.get("resolved_attribute", defaults.get("resolved_attribute", "")).asString();
 
-    std::string not_resolvable = params.get("on_not_resolvable", "").asString();
+    std::string not_resolvable = params.get("on_not_resolvable", defaults.get("on_not_resolvable", "")).asString();
     if(not_resolvable == "EMPTY")
-        on_not_resolvable = HandleNotResolvable::EMPTY;
+        mapping.on_not_resolvable = HandleNotResolvable::EMPTY;
     else if(not_resolvable == "KEEP")
-        on_not_resolvable = HandleNotResolvable::KEEP;
+        mapping.on_not_resolvable = HandleNotResolvable::KEEP;
     else
         throw ArgumentException("Terminology Resolver: on_not_resolvable was not a valid value: " + not_resolvable + ". Must be EMPTY or KEEP.");
 
-    match_type = params.get("match_type", "exact").asString();
-    if(match_type != "exact" && match_type != "included" && match_type != "regex")
-        throw ArgumentException("Terminology Resolver: unknown match_type (must be exact, included or regex) -> " + match_type);
+    mapping.match_type = params.get("match_type", defaults.get("match_type", "exact")).asString();
+    if(mapping.match_type != "exact" && mapping.match_type != "included" && mapping.match_type != "regex")
+        throw ArgumentException("Terminology Resolver: unknown match_type (must be exact, included or regex) -> " + mapping.match_type);
 
-    first_hit  = params.get("first_hit", "true").asBool();
+    mapping.first_hit  = params.get("first_hit", defaults.get("first_hit", "true")).asBool();
+
+    return mapping;
 }
 
 TerminologyResolver::~TerminologyResolver() { }
 
 REGISTER_OPERATOR(TerminologyResolver, "terminology_resolver");
 
-std::unique_ptr<PointCollection>
-TerminologyResolver::getPointCollection(const QueryRectangle &rect, const QueryTools &tools) {
-    auto points = getPointCollectionFromSource(0, rect, tools);
-
-    // with AttributeArray being private, with no direct access to the underlying vector the strings have
-    // to be copied into a new vector first.
-    // the AttributeArray can not be passed to Terminology, because the class is private.
-
-    auto &old_attribute_array = points->feature_attributes.textual(attribute_name);
-    auto &new_attribute_array = points->feature_attributes.addTextualAttribute(resolved_attribute, old_attribute_array.unit);
+namespace {
+    /**
+     * the number of new distinct names that are collected before their resolution starts
+     */
+    constexpr size_t PIPELINE_CHUNK_SIZE = 256;
+
+    /**
+     * hashing and comparing the strings an attribute array holds without copying them
+     */
+    struct StringPointerHash {
+        size_t operator()(const std::string *string) const {
+            return std::hash<std::string>()(*string);
+        }
+    };
+
+    struct StringPointerEqual {
+        bool operator()(const std::string *a, const std::string *b) const {
+            return *a == *b;
+        }
+    };
+}
 
-    std::vector<std::string> names_in;
-    size_t feature_count = points->getFeatureCount();
-    names_in.reserve(feature_count);
+void TerminologyResolver::resolveAttributes(SimpleFeatureCollection &collection) {
+    // the attributes are dictionary encoded: a hash map from the strings in the AttributeArray to their index
+    // among the distinct names, so only the distinct names are copied and passed to Terminology, and each
+    // feature keeps just the index of its name.
+
+    const size_t feature_count = collection.getFeatureCount();
+
+    // all pipelines exist before the first scan, so the requests of later attributes overlap with earlier ones
+    std::vector<std::unique_ptr<Terminology::Pipeline>> pipelines;
+    std::map<std::string, std::vector<size_t>> mappings_by_attribute;
+    for(size_t m = 0; m < mappings.size(); m++){
+        const Mapping &mapping = mappings[m];
+        pipelines.push_back(std::make_unique<Terminology::Pipeline>(mapping.terminology, mapping.key, mapping.match_type,
+                                                                    mapping.first_hit, mapping.on_not_resolvable));
+        mappings_by_attribute[mapping.attribute_name].push_back(m);
+    }
 
-    for(int i = 0; i < feature_count; i++){
-        names_in.push_back(old_attribute_array.get(i));
+    struct EncodedAttribute {
+        std::vector<std::string> names_in;
+        std::vector<size_t> indices;
+    };
+    std::map<std::string, EncodedAttribute> encoded_attributes;
+
+    for(auto &attribute : mappings_by_attribute){
+        auto &old_attribute_array = collection.feature_attributes.textual(attribute.first);
+        EncodedAttribute &encoded = encoded_attributes[attribute.first];
+        encoded.indices.resize(feature_count);
+
+        // dictionary encode the attribute in one pass, only the distinct names are copied.
+        // new names are handed to the pipelines in chunks, so their requests run while the rest is scanned.
+        std::unordered_map<const std::string *, size_t, StringPointerHash, StringPointerEqual> dictionary;
+        std::vector<std::string> chunk;
+
+        for(size_t i = 0; i < feature_count; i++){
+            const std::string &name = old_attribute_array.get(i);
+            auto entry = dictionary.emplace(&name, encoded.names_in.size());
+            if(entry.second) {
+                encoded.names_in.push_back(name);
+                chunk.push_back(name);
+                if(chunk.size() == PIPELINE_CHUNK_SIZE) {
+                    for(size_t m : attribute.second)
+                        pipelines[m]->add(chunk);
+                    chunk.clear();
+                }
+            }
+            encoded.indices[i] = entry.first->second;
+        }
+
+        for(size_t m : attribute.second)
+            pipelines[m]->add(chunk);
     }
 
-    auto names_out = Terminology::resolveMultiple(names_in, terminology, key, match_type, first_hit, on_not_resolvable);
+    for(size_t m = 0; m < mappings.size(); m++){
+        const Mapping &mapping = mappings[m];
+        const EncodedAttribute &encoded = encoded_attributes.at(mapping.attribute_name);
 
-    new_attribute_array.reserve(names_out.size());
+        auto names_out = pipelines[m]->resolve(encoded.names_in);
 
-    // insert the resolved strings into the new attribute array.
-    for(int i = 0; i < names_out.size(); i++){
-        new_attribute_array.set(i, names_out[i]);
+        auto &old_attribute_array = collection.feature_attributes.textual(mapping.attribute_name);
+        auto &new_attribute_array = collection.feature_attributes.addTextualAttribute(mapping.resolved_attribute, old_attribute_array.unit);
+        new_attribute_array.reserve(feature_count);
+
+        // insert the resolved strings into the new attribute array.
+        for(size_t i = 0; i < feature_count; i++){
+            new_attribute_array.set(i, names_out[encoded.indices[i]]);
+        }
     }
+}
 
+std::unique_ptr<PointCollection>
+TerminologyResolver::getPointCollection(const QueryRectangle &rect, const QueryTools &tools) {
+    auto points = getPointCollectionFromSource(0, rect, tools);
+    resolveAttributes(*points);
     return points;
 }
 
 std::unique_ptr<LineCollection>
 TerminologyResolver::getLineCollection(const QueryRectangle &rect, const QueryTools &tools) {
     auto lines = getLineCollectionFromSource(0, rect, tools);
-
-    auto &old_attribute_array = lines->feature_attributes.textual(attribute_name);
-    auto &new_attribute_array = lines->feature_attributes.addTextualAttribute(resolved_attribute, old_attribute_array.unit);
-
-    std::vector<std::string> names_in;
-    size_t feature_count = lines->getFeatureCount();
-    names_in.reserve(feature_count);
-
-    for(int i = 0; i < feature_count; i++){
-        names_in.push_back(old_attribute_array.get(i));
-    }
-
-    auto names_out = Terminology::resolveMultiple(names_in, terminology, key, match_type, first_hit, on_not_resolvable);
-
-    new_attribute_array.reserve(names_out.size());
-
-    // insert the resolved strings into the new attribute array.
-    for(int i = 0; i < names_out.size(); i++){
-        new_attribute_array.set(i, names_out[i]);
-    }
-
+    resolveAttributes(*lines);
     return lines;
 }
 
 std::unique_ptr<PolygonCollection>
 TerminologyResolver::getPolygonCollection(const QueryRectangle &rect, const QueryTools &tools) {
     auto polygons = getPolygonCollectionFromSource(0, rect, tools);
+    resolveAttributes(*polygons);
+    return polygons;
+}
 
-    auto &old_attribute_array = polygons->feature_attributes.textual(attribute_name);
-    auto &new_attribute_array = polygons->feature_attributes.addTextualAttribute(resolved_attribute, old_attribute_array.unit);
-
-    std::vector<std::string> names_in;
-    size_t feature_count = polygons->getFeatureCount();
-    names_in.reserve(feature_count);
-
-    for(int i = 0; i < feature_count; i++){
-        names_in.push_back(old_attribute_array.get(i));
-    }
-
-    auto names_out = Terminology::resolveMultiple(names_in, terminology, key, match_type, first_hit, on_not_resolvable);
-
-    new_attribute_array.reserve(names_out.size());
+Json::Value TerminologyResolver::toJson(const Mapping &mapping) {
+    Json::Value json(Json::objectValue);
 
-    // insert the resolved strings into the new attribute array.
-    for(int i = 0; i < names_out.size(); i++){
-        new_attribute_array.set(i, names_out[i]);
-    }
+    json["attribute_name"]      = mapping.attribute_name;
+    json["resolved_attribute"]  = mapping.resolved_attribute;
+    json["terminology"]         = mapping.terminology;
+    json["key"]                 = mapping.key;
+    json["match_type"]          = mapping.match_type;
+    json["first_hit"]           = mapping.first_hit;
+    json["on_not_resolvable"]   = (mapping.on_not_resolvable == HandleNotResolvable::EMPTY) ? "EMPTY" : "KEEP";
 
-    return polygons;
+    return json;
 }
 
 void TerminologyResolver::writeSemanticParameters(std::ostringstream &stream) {
-    Json::Value json(Json::objectValue);
+    // a single mapping keeps the semantic id of the operator without mappings
+    if(mappings.size() == 1) {
+        stream << toJson(mappings.front());
+        return;
+    }
 
-    json["attribute_name"]      = attribute_name;
-    json["resolved_attribute"]  = resolved_attribute;
-    json["terminology"]         = terminology;
-    json["key"]                 = key;
-    json["match_type"]          = match_type;
-    json["first_hit"]           = first_hit;
-    json["on_not_resolvable"]   = (on_not_resolvable == HandleNotResolvable::EMPTY) ? "EMPTY" : "KEEP";
+    Json::Value json(Json::objectValue);
+    json["mappings"] = Json::Value(Json::arrayValue);
+    for(auto &mapping : mappings)
+        json["mappings"].append(toJson(mapping));
 
     stream << json;
 }
-
@@ -1,6 +1,7 @@
 #include "basketapi.h"
 
 #include "util/curl.h"
+#include "util/curlpool.h"
 #include "util/gfbiodatautil.h"
 #include "util/configuration.h"
 #include "util/pangaeaapi.h"
@@ -99,7 +100,8 @@ Json::Value BasketAPI::BasketEntry::toJson() const {
 BasketAPI::BasketEntry::BasketEntry() = default;
 
 BasketAPI::PangaeaBasketEntry::PangaeaBasketEntry(const std::string &doi, const bool vatVisualizable) {
-    PangaeaAPI::MetaData metaData = PangaeaAPI::getMetaData(doi);
+    auto sharedMetaData = PangaeaAPI::getMetaData(doi);
+    const PangaeaAPI::MetaData &metaData = *sharedMetaData;
     this->doi = doi;
 
     this->authors = metaData.authors;
@@ -312,7 +314,7 @@ BasketAPI::BasketsOverview BasketAPI::getBaskets(const std::string &goestern_id,
 
     std::stringstream data;
 
-    cURL curl;
+    auto curl = cURLPool::acquire();
     curl.setOpt(CURLOPT_PROXY, Configuration::get<std::string>("proxy", "").c_str());
     curl.setOpt(CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
     curl.setOpt(CURLOPT_USERPWD, authentication.c_str());
@@ -339,7 +341,7 @@ BasketAPI::BasketsOverview BasketAPI::getBaskets(const std::string &goestern_id,
 BasketAPI::Basket BasketAPI::getBasket(size_t basketId) {
     // get basket from portal
     std::stringstream data;
-    cURL curl;
+    auto curl = cURLPool::acquire();
     curl.setOpt(CURLOPT_PROXY, Configuration::get<std::string>("proxy", "").c_str());
     curl.setOpt(CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
     curl.setOpt(CURLOPT_USERPWD, concat(Configuration::get<std::string>("gfbio.portal.user"), ":",
@@ -3,6 +3,8 @@
 #include "util/configuration.h"
 #include "util/concat.h"
 #include "util/gfbiodatautil.h"
+#include "util/tilecache.h"
+#include "util/terminologysnapshot.h"
 #include "portal/basketapi.h"
 #include "openid_connect.h"
 
@@ -27,6 +29,17 @@
  *   - parameters:
  *     - id: the id of the basket
  * - request = abcd: get list of available abcd archives
+ * - request = tile: get occurrences as Mapbox Vector Tile (EPSG:3857), requires a session
+ *   - parameters:
+ *     - z, x, y: the tile coordinates
+ *     - term, level: the taxon of the GBIF occurrences
+ *     - or path: the ABCD archive
+ * - request = refreshProjections: create and refresh the narrow projections of gbif.gbif
+ *   for the most frequently requested column sets (requires permission `gfbio.projections.refresh`)
+ * - request = importTerminology: download all terms of a terminology into a local snapshot
+ *   (requires permission `gfbio.terminology.import`)
+ *   - parameters:
+ *     - terminology: the acronym of the terminology
  */
 class GFBioService : public HTTPService {
     public:
@@ -54,6 +67,12 @@ class GFBioService : public HTTPService {
 
         void pangaeaDataSet();
 
+        void tile();
+
+        void refresh_projections(UserDB::User &user);
+
+        void import_terminology(UserDB::User &user);
+
         void baskets(const std::string &goestern_id);
 
         void basket(const std::string &goestern_id);
@@ -80,6 +99,13 @@ void GFBioService::run() {
 
         auto session = UserDB::loadSession(params.get("sessiontoken"));
 
+        // tiles read the same data as the other data requests, so they require a session as well
+        if (request == "tile") return tile();
+
+        if (request == "refreshProjections") return refresh_projections(session->getUser());
+
+        if (request == "importTerminology") return import_terminology(session->getUser());
+
         std::string goestern_id = session->getUser().getExternalid();
         if (goestern_id.find(OpenIdConnectService::EXTERNAL_ID_PREFIX) != 0) { // NOLINT(abseil-string-find-startswith)
             throw GFBioServiceException("GFBioService: This service is only available for GFBio users.");
@@ -131,6 +157,83 @@ void GFBioService::pangaeaDataSet() {
     response.sendSuccessJSON(json);
 }
 
+void GFBioService::tile() {
+    const int z = params.getInt("z");
+    const int x = params.getInt("x");
+    const int y = params.getInt("y");
+
+    std::string source;
+    std::string term;
+    std::string level;
+    std::string archive;
+
+    if (params.hasParam("path")) {
+        archive = params.get("path");
+        source = concat("abcd:", archive);
+    } else {
+        term = params.get("term");
+        if (term.size() < 3) {
+            response.sendFailureJSON("Term has to be >= 3 characters");
+            return;
+        }
+        level = params.get("level");
+        source = concat("gbif:", level, ":", term);
+    }
+
+    const auto key = TileCache::key(source, z, x, y);
+
+    std::string tile;
+    if (!TileCache::get(key, tile)) {
+        if (archive.empty()) {
+            tile = GFBioDataUtil::getGBIFTile(term, level, z, x, y);
+        } else {
+            tile = GFBioDataUtil::getABCDTile(archive, z, x, y);
+        }
+
+        // empty tiles are not cached, they may get features with the next data refresh
+        if (!tile.empty()) {
+            TileCache::put(key, tile);
+        }
+    }
+
+    response.sendContentType("application/vnd.mapbox-vector-tile");
+    response.sendHeader("Cache-Control", tile.empty() ? "no-cache"
+                                                      : concat("max-age=", Configuration::get<long>("gfbio.tiles.cache.ttl", 86400)));
+    response.finishHeaders();
+    response.write(tile.data(), tile.size());
+}
+
+void GFBioService::refresh_projections(UserDB::User &user) {
+    if (!user.hasPermission("gfbio.projections.refresh")) {
+        throw GFBioServiceException("GFBioService: Permission denied for refreshing projections");
+    }
+
+    const auto max_projections = Configuration::get<size_t>("operators.gfbiosource.projections.max", 8);
+
+    Json::Value projections(Json::arrayValue);
+    for (auto &name : GFBioDataUtil::refreshGBIFProjections(max_projections)) {
+        projections.append(name);
+    }
+
+    Json::Value json(Json::objectValue);
+    json["projections"] = projections;
+    response.sendSuccessJSON(json);
+}
+
+void GFBioService::import_terminology(UserDB::User &user) {
+    if (!user.hasPermission("gfbio.terminology.import")) {
+        throw GFBioServiceException("GFBioService: Permission denied for importing terminologies");
+    }
+
+    const std::string terminology = params.get("terminology");
+    const size_t terms = TerminologySnapshot::import(terminology);
+
+    Json::Value json(Json::objectValue);
+    json["terminology"] = terminology;
+    json["terms"] = static_cast<Json::UInt64>(terms);
+    response.sendSuccessJSON(json);
+}
+
 void GFBioService::abcd() {
     Json::Value dataCenters = GFBioDataUtil::getGFBioDataCentersJSON();
 
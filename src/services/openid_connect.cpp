@@ -1,4 +1,5 @@
 #include "openid_connect.h"
+#include "util/curlpool.h"
 
 void OpenIdConnectService::OpenIdConnectService::run() {
     try {
@@ -88,12 +89,11 @@ auto OpenIdConnectService::jwks_to_pem(const std::string &n, const std::string &
 
 auto OpenIdConnectService::download_jwks(const std::string &url) -> Json::Value {
     std::stringstream data;
-    cURL curl;
+    auto curl = cURLPool::acquire();
     curl.setOpt(CURLOPT_PROXY, Configuration::get<std::string>("proxy", "").c_str());
     curl.setOpt(CURLOPT_URL, url.c_str());
     curl.setOpt(CURLOPT_WRITEFUNCTION, cURL::defaultWriteFunction);
     curl.setOpt(CURLOPT_WRITEDATA, &data);
-    curl.perform();
 
     try {
         curl.perform();
@@ -120,14 +120,13 @@ auto OpenIdConnectService::download_jwks(const std::string &url) -> Json::Value
 
 auto OpenIdConnectService::download_user_data(const std::string &url, const std::string &access_token) -> Json::Value {
     std::stringstream data;
-    cURL curl;
+    auto curl = cURLPool::acquire();
     curl.setOpt(CURLOPT_PROXY, Configuration::get<std::string>("proxy", "").c_str());
     curl.setOpt(CURLOPT_URL, url.c_str());
     curl.setOpt(CURLOPT_HTTPAUTH, CURLAUTH_BEARER); // NOLINT(hicpp-signed-bitwise)
     curl.setOpt(CURLOPT_XOAUTH2_BEARER, access_token.c_str());
     curl.setOpt(CURLOPT_WRITEFUNCTION, cURL::defaultWriteFunction);
     curl.setOpt(CURLOPT_WRITEDATA, &data);
-    curl.perform();
 
     try {
         curl.perform();
@@ -0,0 +1,48 @@
+#include "aimdlimiter.h"
+
+#include <algorithm>
+
+AIMDLimiter::AIMDLimiter(size_t maxLimit, std::chrono::milliseconds latencyTarget)
+        : maxLimit(std::max<size_t>(maxLimit, 1)), latencyTarget(latencyTarget),
+          limit(this->maxLimit), running(0), lastDecrease(clock::now() - latencyTarget) {}
+
+double AIMDLimiter::getLimit() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return limit;
+}
+
+void AIMDLimiter::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    released.wait(lock, [this] { return running < static_cast<size_t>(limit); });
+    ++running;
+}
+
+void AIMDLimiter::release(bool success, clock::duration latency) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        --running;
+
+        const auto now = clock::now();
+        if (success && latency <= latencyTarget) {
+            limit = std::min(maxLimit, limit + 1.0 / limit);
+        } else if (now - lastDecrease >= latencyTarget) {
+            // the requests that were already running when the service became overloaded do not decrease it again
+            limit = std::max(1.0, limit / 2);
+            lastDecrease = now;
+        }
+    }
+    released.notify_all();
+}
+
+AIMDLimiter::Permit::Permit(AIMDLimiter &limiter) : limiter(limiter), start(clock::now()), success(false) {
+    limiter.acquire();
+    start = clock::now();
+}
+
+AIMDLimiter::Permit::~Permit() {
+    limiter.release(success, clock::now() - start);
+}
+
+void AIMDLimiter::Permit::succeeded() {
+    success = true;
+}
@@ -0,0 +1,67 @@
+#ifndef UTIL_AIMDLIMITER_H_
+#define UTIL_AIMDLIMITER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * Adapts the number of concurrent requests to a remote service with additive increase / multiplicative decrease.
+ *
+ * The limit grows by about one for every `limit` requests that succeed faster than the latency target
+ * and is halved when requests fail or are slow, at most once per latency target.
+ */
+class AIMDLimiter {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        /**
+         * A running request, it reports a failure unless `succeeded` was called
+         */
+        class Permit {
+            public:
+                explicit Permit(AIMDLimiter &limiter);
+
+                ~Permit();
+
+                Permit(const Permit &) = delete;
+                Permit &operator=(const Permit &) = delete;
+
+                void succeeded();
+
+            private:
+                AIMDLimiter &limiter;
+                clock::time_point start;
+                bool success;
+        };
+
+        /**
+         * @param maxLimit the initial and maximum number of concurrent requests
+         * @param latencyTarget requests that take longer count as a sign of overload
+         */
+        AIMDLimiter(size_t maxLimit, std::chrono::milliseconds latencyTarget);
+
+        /**
+         * @return the current limit, for logging
+         */
+        double getLimit() const;
+
+    private:
+        /**
+         * Block until fewer requests than the limit are running
+         */
+        void acquire();
+
+        void release(bool success, clock::duration latency);
+
+        const double maxLimit;
+        const clock::duration latencyTarget;
+
+        mutable std::mutex mutex;
+        std::condition_variable released;
+        double limit;
+        size_t running;
+        clock::time_point lastDecrease;
+};
+
+#endif /* UTIL_AIMDLIMITER_H_ */
@@ -0,0 +1,120 @@
+#include "curlpool.h"
+
+#include "util/configuration.h"
+#include "util/concat.h"
+#include "util/exceptions.h"
+
+cURLPool::cURLPool()
+        : capacity(Configuration::get<size_t>("curl.pool.capacity", 16)),
+          http2(Configuration::get<bool>("curl.http2", false)) {
+    share = curl_share_init();
+    if (share == nullptr) {
+        throw cURLException("cURLPool: could not initialize cURL share");
+    }
+
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, cURLPool::lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, cURLPool::unlock);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+    // A shared connection cache outlives the multi handles of streams, which would otherwise close their
+    // connections on cleanup. Sharing connections between threads is unsafe in older libcurl versions,
+    // there each handle keeps its own connections instead.
+    if (curl_version_info(CURLVERSION_NOW)->version_num >= 0x074400) {
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    }
+}
+
+cURLPool &cURLPool::instance() {
+    // never destroyed, so that handles returned during static destruction do not outlive the pool
+    static auto pool = new cURLPool();
+    return *pool;
+}
+
+void cURLPool::lock(CURL *, curl_lock_data data, curl_lock_access, void *userptr) {
+    reinterpret_cast<cURLPool *>(userptr)->shareMutexes[data].lock();
+}
+
+void cURLPool::unlock(CURL *, curl_lock_data data, void *userptr) {
+    reinterpret_cast<cURLPool *>(userptr)->shareMutexes[data].unlock();
+}
+
+cURLPool::Handle cURLPool::acquire() {
+    cURLPool &pool = instance();
+
+    std::unique_ptr<Entry> entry;
+    {
+        std::lock_guard<std::mutex> guard(pool.mutex);
+        if (!pool.idle.empty()) {
+            entry = std::move(pool.idle.back());
+            pool.idle.pop_back();
+        }
+    }
+
+    if (!entry) {
+        entry = std::make_unique<Entry>();
+        entry->easy = curl_easy_init();
+        if (entry->easy == nullptr) {
+            throw cURLException("cURLPool: could not initialize cURL");
+        }
+    }
+
+    entry->errorBuffer[0] = '\0';
+    curl_easy_setopt(entry->easy, CURLOPT_SHARE, pool.share);
+    curl_easy_setopt(entry->easy, CURLOPT_ERRORBUFFER, entry->errorBuffer);
+    curl_easy_setopt(entry->easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    if (pool.http2) {
+        curl_easy_setopt(entry->easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    }
+
+    return Handle(std::move(entry));
+}
+
+void cURLPool::release(std::unique_ptr<Entry> entry) {
+    // resetting keeps the open connections and caches of the handle
+    curl_easy_reset(entry->easy);
+
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (idle.size() < capacity) {
+            idle.push_back(std::move(entry));
+            return;
+        }
+    }
+
+    curl_easy_cleanup(entry->easy);
+}
+
+cURLPool::Handle::Handle(std::unique_ptr<Entry> entry) : entry(std::move(entry)) {}
+
+cURLPool::Handle &cURLPool::Handle::operator=(Handle &&other) noexcept {
+    if (this != &other) {
+        if (entry) {
+            instance().release(std::move(entry));
+        }
+        entry = std::move(other.entry);
+    }
+    return *this;
+}
+
+cURLPool::Handle::~Handle() {
+    if (entry) {
+        instance().release(std::move(entry));
+    }
+}
+
+void cURLPool::Handle::perform() {
+    entry->errorBuffer[0] = '\0';
+    CURLcode result = curl_easy_perform(entry->easy);
+    if (result != CURLE_OK) {
+        throw cURLException(concat("cURLPool: request failed: ",
+                                   entry->errorBuffer[0] != '\0' ? entry->errorBuffer : curl_easy_strerror(result)));
+    }
+}
+
+long cURLPool::Handle::getResponseCode() const {
+    long responseCode = 0;
+    curl_easy_getinfo(entry->easy, CURLINFO_RESPONSE_CODE, &responseCode);
+    return responseCode;
+}
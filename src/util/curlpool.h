@@ -0,0 +1,85 @@
+#ifndef UTIL_CURLPOOL_H_
+#define UTIL_CURLPOOL_H_
+
+#include <curl/curl.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * A process-wide pool of reusable cURL easy handles.
+ *
+ * A handle keeps its connections open after a request, so the next request to the same host
+ * that borrows it skips the TCP and TLS handshakes. All handles share one DNS and TLS session cache and,
+ * with libcurl 7.68 or newer, one connection cache, which also keeps the connections of `cURLInputStream`s open.
+ */
+class cURLPool {
+    private:
+        struct Entry {
+            CURL *easy;
+            char errorBuffer[CURL_ERROR_SIZE];
+        };
+
+    public:
+        /**
+         * A handle borrowed from the pool, usable like `cURL`. It is reset and returned to the pool on destruction.
+         */
+        class Handle {
+            public:
+                Handle(Handle &&) noexcept = default;
+                /**
+                 * Returns the handle's current entry to the pool before taking over the other one
+                 */
+                Handle &operator=(Handle &&other) noexcept;
+
+                ~Handle();
+
+                template<typename T>
+                void setOpt(CURLoption option, T value) {
+                    curl_easy_setopt(entry->easy, option, value);
+                }
+
+                /**
+                 * Perform the request, throws a cURLException if it failed
+                 */
+                void perform();
+
+                long getResponseCode() const;
+
+                CURL *get() const {
+                    return entry->easy;
+                }
+
+            private:
+                friend class cURLPool;
+
+                explicit Handle(std::unique_ptr<Entry> entry);
+
+                std::unique_ptr<Entry> entry;
+        };
+
+        /**
+         * Borrow an idle handle or create a new one
+         */
+        static Handle acquire();
+
+    private:
+        cURLPool();
+
+        static cURLPool &instance();
+
+        void release(std::unique_ptr<Entry> entry);
+
+        static void lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr);
+        static void unlock(CURL *handle, curl_lock_data data, void *userptr);
+
+        CURLSH *share;
+        std::mutex shareMutexes[CURL_LOCK_DATA_LAST];
+
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Entry>> idle;
+        size_t capacity;
+        bool http2;
+};
+
+#endif /* UTIL_CURLPOOL_H_ */
@@ -0,0 +1,96 @@
+#include "curlstream.h"
+
+#include "util/configuration.h"
+#include "util/concat.h"
+#include "util/exceptions.h"
+
+cURLStreamBuffer::cURLStreamBuffer(const std::string &url)
+        : handle(cURLPool::acquire()), easy(handle.get()), running(true), errorBuffer{} {
+    multi = curl_multi_init();
+
+    if (multi == nullptr) {
+        throw cURLException("cURLStreamBuffer: could not initialize cURL");
+    }
+
+    curl_easy_setopt(easy, CURLOPT_PROXY, Configuration::get<std::string>("proxy", "").c_str());
+    curl_easy_setopt(easy, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(easy, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, errorBuffer);
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, cURLStreamBuffer::writeFunction);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
+
+    curl_multi_add_handle(multi, easy);
+
+    setg(nullptr, nullptr, nullptr);
+}
+
+cURLStreamBuffer::~cURLStreamBuffer() {
+    curl_multi_remove_handle(multi, easy);
+    curl_multi_cleanup(multi);
+}
+
+size_t cURLStreamBuffer::writeFunction(char *ptr, size_t size, size_t nmemb, void *userdata) {
+    auto streamBuffer = reinterpret_cast<cURLStreamBuffer *>(userdata);
+    streamBuffer->buffer.insert(streamBuffer->buffer.end(), ptr, ptr + size * nmemb);
+    return size * nmemb;
+}
+
+void cURLStreamBuffer::receive() {
+    while (buffer.empty() && running) {
+        int stillRunning = 0;
+        CURLMcode code = curl_multi_perform(multi, &stillRunning);
+        if (code != CURLM_OK) {
+            error = curl_multi_strerror(code);
+            running = false;
+            break;
+        }
+
+        if (stillRunning == 0) {
+            running = false;
+
+            int messages = 0;
+            while (CURLMsg *message = curl_multi_info_read(multi, &messages)) {
+                if (message->msg == CURLMSG_DONE && message->data.result != CURLE_OK) {
+                    error = errorBuffer[0] != '\0' ? errorBuffer : curl_easy_strerror(message->data.result);
+                }
+            }
+            break;
+        }
+
+        if (buffer.empty()) {
+            curl_multi_wait(multi, nullptr, 0, 1000, nullptr);
+        }
+    }
+}
+
+cURLStreamBuffer::int_type cURLStreamBuffer::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    // everything received so far was consumed
+    buffer.clear();
+    receive();
+
+    if (buffer.empty()) {
+        setg(nullptr, nullptr, nullptr);
+        return traits_type::eof();
+    }
+
+    setg(buffer.data(), buffer.data(), buffer.data() + buffer.size());
+    return traits_type::to_int_type(*gptr());
+}
+
+void cURLStreamBuffer::checkTransfer() const {
+    if (!error.empty()) {
+        throw cURLException(concat("cURLStreamBuffer: transfer failed: ", error));
+    }
+}
+
+long long cURLStreamBuffer::getContentLength() const {
+    curl_off_t length = -1;
+    if (curl_easy_getinfo(easy, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length) != CURLE_OK) {
+        return -1;
+    }
+    return length;
+}
@@ -0,0 +1,82 @@
+#ifndef UTIL_CURLSTREAM_H_
+#define UTIL_CURLSTREAM_H_
+
+#include "util/curlpool.h"
+
+#include <curl/curl.h>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+/**
+ * A stream buffer that downloads a url while it is being read.
+ *
+ * The transfer is driven by the reader through a cURL multi handle, so only the
+ * received data that has not been consumed yet is held in memory. The easy handle is borrowed
+ * from the `cURLPool`, whose shared connection cache keeps the connection open after the stream's
+ * multi handle is cleaned up.
+ */
+class cURLStreamBuffer : public std::streambuf {
+    public:
+        explicit cURLStreamBuffer(const std::string &url);
+
+        ~cURLStreamBuffer() override;
+
+        cURLStreamBuffer(const cURLStreamBuffer &) = delete;
+        cURLStreamBuffer &operator=(const cURLStreamBuffer &) = delete;
+
+        /**
+         * Throws a cURLException if the transfer failed.
+         * Streams report errors as end of file, so this has to be checked after reading.
+         */
+        void checkTransfer() const;
+
+        /**
+         * @return the size announced by the server, -1 if it is unknown or the response did not start yet
+         */
+        long long getContentLength() const;
+
+    protected:
+        int_type underflow() override;
+
+    private:
+        static size_t writeFunction(char *ptr, size_t size, size_t nmemb, void *userdata);
+
+        /**
+         * Advance the transfer until new data arrived or the transfer finished
+         */
+        void receive();
+
+        cURLPool::Handle handle;
+        CURL *easy;
+        CURLM *multi;
+
+        std::vector<char> buffer;
+        bool running;
+        std::string error;
+        char errorBuffer[CURL_ERROR_SIZE];
+};
+
+/**
+ * An input stream reading the content of a url, see `cURLStreamBuffer`
+ */
+class cURLInputStream : public std::istream {
+    public:
+        explicit cURLInputStream(const std::string &url) : std::istream(nullptr), streamBuffer(url) {
+            rdbuf(&streamBuffer);
+        }
+
+        void checkTransfer() const {
+            streamBuffer.checkTransfer();
+        }
+
+        long long getContentLength() const {
+            return streamBuffer.getContentLength();
+        }
+
+    private:
+        cURLStreamBuffer streamBuffer;
+};
+
+#endif /* UTIL_CURLSTREAM_H_ */
@@ -0,0 +1,102 @@
+#include "fairexecutor.h"
+
+FairExecutor::FairExecutor(size_t threads) : stopped(false) {
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(&FairExecutor::work, this);
+    }
+}
+
+FairExecutor::~FairExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+    }
+    available.notify_all();
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void FairExecutor::run(std::vector<std::function<void()>> tasks) {
+    Group group(*this);
+    for (auto &task : tasks) {
+        group.submit(std::move(task));
+    }
+    group.wait();
+}
+
+FairExecutor::Group::Group(FairExecutor &executor) : executor(executor), batch(std::make_shared<Batch>()) {
+    batch->pending = 0;
+}
+
+FairExecutor::Group::~Group() {
+    // the tasks may still refer to the state of the caller
+    std::unique_lock<std::mutex> lock(executor.mutex);
+    batch->finished.wait(lock, [this] { return batch->pending == 0; });
+}
+
+void FairExecutor::Group::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(executor.mutex);
+        // a batch without waiting tasks is not in line for a turn
+        if (batch->tasks.empty()) {
+            executor.batches.push_back(batch);
+        }
+        batch->tasks.push_back(std::move(task));
+        ++batch->pending;
+    }
+    executor.available.notify_one();
+}
+
+void FairExecutor::Group::wait() {
+    std::unique_lock<std::mutex> lock(executor.mutex);
+    batch->finished.wait(lock, [this] { return batch->pending == 0; });
+
+    if (batch->exception) {
+        std::exception_ptr exception = batch->exception;
+        batch->exception = nullptr;
+        std::rethrow_exception(exception);
+    }
+}
+
+void FairExecutor::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        available.wait(lock, [this] { return stopped || !batches.empty(); });
+        if (stopped) {
+            return;
+        }
+
+        // take one task of the batch whose turn it is and move the batch to the end of the line
+        std::shared_ptr<Batch> batch = batches.front();
+        batches.pop_front();
+        std::function<void()> task = std::move(batch->tasks.front());
+        batch->tasks.pop_front();
+        if (!batch->tasks.empty()) {
+            batches.push_back(batch);
+        }
+
+        lock.unlock();
+        std::exception_ptr exception;
+        try {
+            task();
+        } catch (...) {
+            exception = std::current_exception();
+        }
+        lock.lock();
+
+        if (exception && !batch->exception) {
+            batch->exception = exception;
+        }
+        if (--batch->pending == 0) {
+            batch->finished.notify_all();
+        }
+    }
+}
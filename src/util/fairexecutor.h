@@ -0,0 +1,85 @@
+#ifndef UTIL_FAIREXECUTOR_H_
+#define UTIL_FAIREXECUTOR_H_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A long-lived pool of worker threads shared by several callers.
+ *
+ * The number of threads caps the number of tasks running at once across all callers.
+ * Workers take the tasks of the waiting batches in turns, so a batch with many tasks does not delay the others.
+ */
+class FairExecutor {
+    public:
+        explicit FairExecutor(size_t threads);
+
+        ~FairExecutor();
+
+        FairExecutor(const FairExecutor &) = delete;
+        FairExecutor &operator=(const FairExecutor &) = delete;
+
+        /**
+         * Run a batch of tasks and wait until all of them finished.
+         * If tasks threw, the first exception is rethrown after the whole batch finished.
+         * Must not be called from a task.
+         */
+        void run(std::vector<std::function<void()>> tasks);
+
+    private:
+        struct Batch;
+
+    public:
+        /**
+         * A batch whose tasks are submitted one after another while the earlier ones already run.
+         * The destructor waits for the submitted tasks.
+         */
+        class Group {
+            public:
+                explicit Group(FairExecutor &executor);
+
+                ~Group();
+
+                Group(const Group &) = delete;
+                Group &operator=(const Group &) = delete;
+
+                void submit(std::function<void()> task);
+
+                /**
+                 * Wait until all submitted tasks finished, the first exception of a task is rethrown.
+                 * Must not be called from a task.
+                 */
+                void wait();
+
+            private:
+                FairExecutor &executor;
+                std::shared_ptr<Batch> batch;
+        };
+
+    private:
+        struct Batch {
+            std::deque<std::function<void()>> tasks;
+            size_t pending;
+            std::exception_ptr exception;
+            std::condition_variable finished;
+        };
+
+        void work();
+
+        std::mutex mutex;
+        std::condition_variable available;
+        /// batches with tasks that were not started yet, in the order they get their next turn
+        std::list<std::shared_ptr<Batch>> batches;
+        bool stopped;
+
+        std::vector<std::thread> workers;
+};
+
+#endif /* UTIL_FAIREXECUTOR_H_ */
@@ -0,0 +1,97 @@
+#include "fastparse.h"
+
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <locale.h>
+#include <string>
+
+/**
+ * powers of ten that are exactly representable as double
+ */
+static const double exactPowersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+double FastParse::parseDouble(const char *begin, size_t length) {
+	if(length == 0)
+		return NAN;
+
+	const char *p = begin;
+	const char *end = begin + length;
+
+	bool negative = false;
+	if(*p == '-' || *p == '+') {
+		negative = *p == '-';
+		++p;
+	}
+
+	uint64_t mantissa = 0;
+	int significantDigits = 0;
+	int exponent = 0;
+	bool hasDigits = false;
+
+	for(; p < end && *p >= '0' && *p <= '9'; ++p) {
+		mantissa = mantissa * 10 + (*p - '0');
+		if(mantissa != 0)
+			++significantDigits;
+		hasDigits = true;
+	}
+	if(p < end && *p == '.') {
+		for(++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if(mantissa != 0)
+				++significantDigits;
+			--exponent;
+			hasDigits = true;
+		}
+	}
+	if(hasDigits && p < end && (*p == 'e' || *p == 'E')) {
+		++p;
+		bool negativeExponent = false;
+		if(p < end && (*p == '-' || *p == '+')) {
+			negativeExponent = *p == '-';
+			++p;
+		}
+		if(p == end)
+			return NAN;
+
+		int explicitExponent = 0;
+		for(; p < end && *p >= '0' && *p <= '9'; ++p) {
+			if(explicitExponent < 10000)
+				explicitExponent = explicitExponent * 10 + (*p - '0');
+		}
+		exponent += negativeExponent ? -explicitExponent : explicitExponent;
+	}
+
+	// the mantissa and the power of ten are exact, so a single operation rounds correctly
+	if(!hasDigits || p != end || significantDigits > 19 || mantissa > (uint64_t(1) << 53) || exponent < -22 || exponent > 22)
+		return parseDoubleSlow(begin, length);
+
+	double value = static_cast<double>(mantissa);
+	value = exponent < 0 ? value / exactPowersOfTen[-exponent] : value * exactPowersOfTen[exponent];
+	return negative ? -value : value;
+}
+
+double FastParse::parseDoubleSlow(const char *begin, size_t length) {
+	static const locale_t cLocale = newlocale(LC_NUMERIC_MASK, "C", static_cast<locale_t>(0));
+
+	// strtod needs a terminated string, long fields are copied to the heap
+	char stackBuffer[64];
+	std::string heapBuffer;
+	char *buffer = stackBuffer;
+	if(length >= sizeof(stackBuffer)) {
+		heapBuffer.assign(begin, length);
+		buffer = &heapBuffer[0];
+	} else {
+		std::memcpy(buffer, begin, length);
+		buffer[length] = '\0';
+	}
+
+	char *end;
+	double value = strtod_l(buffer, &end, cLocale);
+	return end == buffer + length ? value : NAN;
+}
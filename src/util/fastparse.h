@@ -0,0 +1,48 @@
+#ifndef UTIL_FASTPARSE_H_
+#define UTIL_FASTPARSE_H_
+
+#include <cstddef>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Building blocks for parsing large delimited text files
+ */
+class FastParse {
+public:
+	/**
+	 * Find the first occurrence of a byte, scanning 16 bytes at a time
+	 * @return a pointer to the byte or `end` if it does not occur
+	 */
+	static const char *find(const char *begin, const char *end, char c) {
+#ifdef __SSE2__
+		const __m128i needle = _mm_set1_epi8(c);
+		while(end - begin >= 16) {
+			__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+			int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+			if(mask != 0)
+				return begin + __builtin_ctz(mask);
+			begin += 16;
+		}
+#endif
+		if(begin >= end)
+			return end;
+		const void *found = std::memchr(begin, c, end - begin);
+		return found != nullptr ? static_cast<const char *>(found) : end;
+	}
+
+	/**
+	 * Parse a field as double independent of the current locale. Plain decimal numbers are converted
+	 * directly, everything else is handed to `strtod` in the "C" locale. The result is identical to `strtod`.
+	 * @return the value or NaN if the field is empty or not entirely a number
+	 */
+	static double parseDouble(const char *begin, size_t length);
+
+private:
+	static double parseDoubleSlow(const char *begin, size_t length);
+};
+
+#endif /* UTIL_FASTPARSE_H_ */
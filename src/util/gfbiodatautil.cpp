@@ -3,10 +3,40 @@
 #include "util/enumconverter.h"
 #include "gfbiodatautil.h"
 #include "util/configuration.h"
+#include "util/sha1.h"
+#include "util/stringsplit.h"
+#include "util/log.h"
 
+#include <algorithm>
+#include <ctime>
 #include <fstream>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <set>
 
 
+/**
+ * format a list of strings as postgres array literal
+ */
+static std::string toArrayLiteral(const std::vector<std::string> &values) {
+	std::stringstream array;
+	array << "{";
+	for(size_t i = 0; i < values.size(); ++i) {
+		if(i != 0)
+			array << ",";
+		array << "\"";
+		for(char c : values[i]) {
+			if(c == '"' || c == '\\')
+				array << '\\';
+			array << c;
+		}
+		array << "\"";
+	}
+	array << "}";
+	return array.str();
+}
+
 std::string GFBioDataUtil::resolveTaxa(pqxx::connection &connection, std::string &term, std::string &level) {
 	connection.prepare("taxa", "SELECT DISTINCT taxon FROM gbif.taxon_to_term WHERE level = lower($1) and term ILIKE $2");
 	pqxx::work work(connection);
@@ -26,6 +56,10 @@ std::string GFBioDataUtil::resolveTaxa(pqxx::connection &connection, std::string
 std::string GFBioDataUtil::resolveTaxaNames(pqxx::connection &connection, std::string &term, std::string &level) {
 	std::string taxa = resolveTaxa(connection, term, level);
 
+	return resolveNamesOfTaxa(connection, taxa);
+}
+
+std::string GFBioDataUtil::resolveNamesOfTaxa(pqxx::connection &connection, const std::string &taxa) {
 	connection.prepare("taxaNames", "SELECT DISTINCT lower(name) FROM gbif.gbif_taxon_to_name WHERE taxon = ANY($1) AND name != ''");
 	pqxx::work work(connection);
 	pqxx::result result = work.prepared("taxaNames")(taxa).exec();
@@ -41,6 +75,240 @@ std::string GFBioDataUtil::resolveTaxaNames(pqxx::connection &connection, std::s
 	return taxaNames.str();
 }
 
+static void createGBIFProjectionCatalog(pqxx::connection &connection) {
+	pqxx::work work(connection);
+	work.exec("CREATE TABLE IF NOT EXISTS gbif.column_usage (columns text[] PRIMARY KEY, requests bigint NOT NULL DEFAULT 1, last_requested timestamptz NOT NULL DEFAULT now())");
+	work.exec("CREATE TABLE IF NOT EXISTS gbif.projections (name text PRIMARY KEY, columns text[] NOT NULL)");
+	work.commit();
+}
+
+/**
+ * In-memory state of the projection catalog of a process.
+ * The projections are reloaded periodically instead of looking them up for every query and the column usage is
+ * written in batches.
+ */
+struct GBIFProjectionCatalog {
+	std::mutex mutex;
+	time_t loaded = 0;
+	bool available = false;
+	std::vector<std::pair<std::string, std::vector<std::string>>> projections; // sorted columns, narrowest first
+	std::map<std::string, size_t> pendingUsage; // array literal of the columns -> requests
+	size_t pendingRequests = 0;
+	time_t flushed = 0;
+};
+
+static GBIFProjectionCatalog gbifProjectionCatalog;
+
+static const time_t GBIF_CATALOG_RELOAD_SECONDS = 60;
+static const size_t GBIF_USAGE_BATCH_SIZE = 100;
+
+static std::vector<std::string> parseColumnArray(const std::string &array) {
+	std::vector<std::string> columns;
+	for(auto &column : split(array.substr(1, array.size() - 2), ',')) {
+		// only plain column names are valid, everything else is rejected
+		if(column.empty() || column.find_first_not_of("abcdefghijklmnopqrstuvwxyz") != std::string::npos)
+			throw ArgumentException(concat("GFBioDataUtil: invalid column name in catalog: ", column));
+		columns.push_back(column);
+	}
+	return columns;
+}
+
+/**
+ * Reload the projection catalog if it is outdated. The catalog tables are created by the first `refreshProjections`,
+ * until then there are no projections and no usage is recorded.
+ * The mutex of the catalog must be held.
+ */
+static void reloadGBIFProjectionCatalog(pqxx::connection &connection) {
+	GBIFProjectionCatalog &catalog = gbifProjectionCatalog;
+	time_t now = time(nullptr);
+	if(now - catalog.loaded < GBIF_CATALOG_RELOAD_SECONDS)
+		return;
+
+	catalog.loaded = now;
+	catalog.available = false;
+	catalog.projections.clear();
+
+	try {
+		pqxx::work work(connection);
+		pqxx::result tables = work.exec("SELECT to_regclass('gbif.projections') IS NOT NULL AND to_regclass('gbif.column_usage') IS NOT NULL");
+		if(!tables[0][0].as<bool>())
+			return;
+
+		pqxx::result projections = work.exec("SELECT name, columns FROM gbif.projections ORDER BY array_length(columns, 1) ASC");
+		work.commit();
+
+		for(size_t i = 0; i < projections.size(); ++i) {
+			auto columns = parseColumnArray(projections[i][1].as<std::string>());
+			std::sort(columns.begin(), columns.end());
+			catalog.projections.emplace_back(projections[i][0].as<std::string>(), std::move(columns));
+		}
+		catalog.available = true;
+	} catch (const std::exception &e) {
+		Log::debug(concat("GFBioDataUtil: could not load projections: ", e.what()));
+	}
+}
+
+void GFBioDataUtil::logGBIFColumnUsage(pqxx::connection &connection, const std::vector<std::string> &columns) {
+	GBIFProjectionCatalog &catalog = gbifProjectionCatalog;
+
+	std::map<std::string, size_t> usage;
+	{
+		std::lock_guard<std::mutex> lock(catalog.mutex);
+		reloadGBIFProjectionCatalog(connection);
+		if(!catalog.available)
+			return;
+
+		catalog.pendingUsage[toArrayLiteral(columns)] += 1;
+		catalog.pendingRequests += 1;
+
+		time_t now = time(nullptr);
+		if(catalog.flushed == 0)
+			catalog.flushed = now;
+		if(catalog.pendingRequests < GBIF_USAGE_BATCH_SIZE && now - catalog.flushed < GBIF_CATALOG_RELOAD_SECONDS)
+			return;
+
+		usage.swap(catalog.pendingUsage);
+		catalog.pendingRequests = 0;
+		catalog.flushed = now;
+	}
+
+	std::vector<std::string> columnSets;
+	std::vector<std::string> requests;
+	for(auto &entry : usage) {
+		columnSets.push_back(entry.first);
+		requests.push_back(std::to_string(entry.second));
+	}
+
+	// usage statistics are best effort and must not let the query fail
+	try {
+		connection.prepare("columnUsage", "INSERT INTO gbif.column_usage (columns, requests) "
+				"SELECT u.columns::text[], u.requests::bigint FROM unnest($1::text[], $2::text[]) AS u(columns, requests) "
+				"ON CONFLICT (columns) DO UPDATE SET requests = gbif.column_usage.requests + EXCLUDED.requests, last_requested = now()");
+		pqxx::work work(connection);
+		work.prepared("columnUsage")(toArrayLiteral(columnSets))(toArrayLiteral(requests)).exec();
+		work.commit();
+	} catch (const std::exception &e) {
+		Log::debug(concat("GFBioDataUtil: could not log column usage: ", e.what()));
+	}
+}
+
+std::string GFBioDataUtil::findGBIFProjection(pqxx::connection &connection, const std::vector<std::string> &columns) {
+	GBIFProjectionCatalog &catalog = gbifProjectionCatalog;
+	std::lock_guard<std::mutex> lock(catalog.mutex);
+	reloadGBIFProjectionCatalog(connection);
+
+	std::vector<std::string> sorted(columns);
+	std::sort(sorted.begin(), sorted.end());
+
+	for(auto &projection : catalog.projections) {
+		if(std::includes(projection.second.begin(), projection.second.end(), sorted.begin(), sorted.end()))
+			return projection.first;
+	}
+	return "";
+}
+
+void GFBioDataUtil::invalidateGBIFProjections() {
+	std::lock_guard<std::mutex> lock(gbifProjectionCatalog.mutex);
+	gbifProjectionCatalog.loaded = 0;
+}
+
+std::vector<std::string> GFBioDataUtil::getGBIFProjectionColumns(const std::vector<std::string> &hotColumns) {
+	std::vector<std::string> columns {"taxonkey", "decimallongitude", "decimallatitude", "eventdate"};
+	for(auto &column : hotColumns) {
+		if(std::find(columns.begin(), columns.end(), column) == columns.end())
+			columns.push_back(column);
+	}
+	return columns;
+}
+
+std::vector<std::string> GFBioDataUtil::refreshGBIFProjections(size_t maxProjections) {
+	pqxx::connection connection (Configuration::get<std::string>("operators.gfbiosource.dbcredentials"));
+
+	createGBIFProjectionCatalog(connection);
+
+	pqxx::work work(connection);
+
+	// the most frequently requested column sets of the last 30 days
+	connection.prepare("hotColumnSets", "SELECT columns FROM gbif.column_usage "
+			"WHERE last_requested > now() - interval '30 days' ORDER BY requests DESC LIMIT $1");
+	pqxx::result hotColumnSets = work.prepared("hotColumnSets")(maxProjections).exec();
+
+	std::map<std::string, std::vector<std::string>> wanted;
+	for(size_t i = 0; i < hotColumnSets.size(); ++i) {
+		std::string array = hotColumnSets[i][0].as<std::string>();
+		std::vector<std::string> columns = parseColumnArray(array);
+
+		SHA1 hasher;
+		hasher.addBytes(array);
+		wanted[concat("gbif.projection_", hasher.digest().asHex().substr(0, 16))] = columns;
+	}
+
+	std::set<std::string> existing;
+	pqxx::result projections = work.exec("SELECT name FROM gbif.projections");
+	for(size_t i = 0; i < projections.size(); ++i)
+		existing.insert(projections[i][0].as<std::string>());
+
+	// drop projections that are no longer requested frequently
+	for(auto &name : existing) {
+		if(wanted.find(name) == wanted.end()) {
+			work.exec(concat("DROP MATERIALIZED VIEW IF EXISTS ", name));
+			work.exec(concat("DELETE FROM gbif.projections WHERE name = ", work.quote(name)));
+		}
+	}
+
+	std::vector<std::string> names;
+	for(auto &projection : wanted) {
+		const std::string &name = projection.first;
+
+		if(existing.find(name) != existing.end()) {
+			work.exec(concat("REFRESH MATERIALIZED VIEW ", name));
+		} else {
+			std::stringstream columns;
+			for(auto &column : getGBIFProjectionColumns(projection.second))
+				columns << "\"" << column << "\", ";
+
+			work.exec(concat("CREATE MATERIALIZED VIEW ", name, " AS SELECT ", columns.str(),
+							 "ST_SetSRID(ST_MakePoint(decimallongitude::double precision, decimallatitude::double precision), 4326) AS geom",
+							 " FROM gbif.gbif"));
+			work.exec(concat("CREATE INDEX ON ", name, " (taxonkey)"));
+			work.exec(concat("CREATE INDEX ON ", name, " USING GIST (geom)"));
+			work.exec(concat("INSERT INTO gbif.projections (name, columns) VALUES (", work.quote(name), ", ",
+							 work.quote(toArrayLiteral(projection.second)), ")"));
+		}
+
+		names.push_back(name);
+	}
+
+	work.commit();
+
+	invalidateGBIFProjections();
+
+	return names;
+}
+
+std::map<std::string, size_t> GFBioDataUtil::resolveTaxaOfTerms(pqxx::connection &connection, const std::vector<std::pair<std::string, std::string>> &terms) {
+	std::vector<std::string> searchTerms;
+	std::vector<std::string> levels;
+	for(auto &term : terms) {
+		searchTerms.push_back(term.first);
+		levels.push_back(term.second);
+	}
+
+	connection.prepare("taxaOfTerms", "SELECT DISTINCT ON (t.taxon) t.taxon, q.idx "
+			"FROM unnest($1::text[], $2::text[]) WITH ORDINALITY AS q(term, level, idx) "
+			"JOIN gbif.taxon_to_term t ON t.level = lower(q.level) AND t.term ILIKE q.term || '%' "
+			"ORDER BY t.taxon, q.idx");
+	pqxx::work work(connection);
+	pqxx::result result = work.prepared("taxaOfTerms")(toArrayLiteral(searchTerms))(toArrayLiteral(levels)).exec();
+
+	std::map<std::string, size_t> taxa;
+	for(size_t i = 0; i < result.size(); ++i) {
+		// ordinality is 1-based
+		taxa[result[i][0].as<std::string>()] = result[i][1].as<size_t>() - 1;
+	}
+	return taxa;
+}
+
 size_t GFBioDataUtil::countGBIFResults(std::string &term, std::string &level) {
 	pqxx::connection connection (Configuration::get<std::string>("operators.gfbiosource.dbcredentials"));
 
@@ -137,3 +405,93 @@ std::vector<std::string> GFBioDataUtil::getAvailableABCDArchives() {
     return ids;
 }
 
+
+/**
+ * Compute the bounds of a web mercator (EPSG:3857) tile
+ */
+static void webMercatorTileBounds(int z, int x, int y, double &x1, double &y1, double &x2, double &y2) {
+	const double worldExtent = 20037508.342789244;
+
+	if (z < 0 || z > 30 || x < 0 || y < 0 || x >= (1 << z) || y >= (1 << z))
+		throw ArgumentException(concat("GFBioDataUtil: invalid tile ", z, "/", x, "/", y));
+
+	const double tileSize = 2 * worldExtent / std::pow(2.0, z);
+
+	x1 = -worldExtent + x * tileSize;
+	x2 = x1 + tileSize;
+	y2 = worldExtent - y * tileSize;
+	y1 = y2 - tileSize;
+}
+
+static std::string readTile(const pqxx::result &result) {
+	if (result.empty() || result[0][0].is_null())
+		return "";
+
+	pqxx::binarystring tile(result[0][0]);
+	return tile.str();
+}
+
+std::string GFBioDataUtil::getGBIFTile(std::string &term, std::string &level, int z, int x, int y) {
+	double x1, y1, x2, y2;
+	webMercatorTileBounds(z, x, y, x1, y1, x2, y2);
+
+	pqxx::connection connection (Configuration::get<std::string>("operators.gfbiosource.dbcredentials"));
+
+	std::string taxa = resolveTaxa(connection, term, level);
+
+	connection.prepare("tile",
+			"WITH bounds AS (SELECT ST_MakeEnvelope($2, $3, $4, $5, 3857) AS geom) "
+			"SELECT ST_AsMVT(tile, 'occurrences', 4096, 'geom') FROM ("
+			"SELECT ST_AsMVTGeom(ST_Transform(o.geom, 3857), bounds.geom, 4096, 64, true) AS geom, extract(epoch from o.event_date) AS time "
+			"FROM gbif.gbif_lite_time o, bounds "
+			"WHERE o.taxon = ANY($1) AND o.geom && ST_Transform(bounds.geom, 4326)"
+			") AS tile");
+
+	pqxx::work work(connection);
+	pqxx::result result = work.prepared("tile")(taxa)(x1)(y1)(x2)(y2).exec();
+	work.commit();
+
+	return readTile(result);
+}
+
+std::string GFBioDataUtil::getABCDTile(const std::string &archive, int z, int x, int y) {
+	double x1, y1, x2, y2;
+	webMercatorTileBounds(z, x, y, x1, y1, x2, y2);
+
+	// ABCD columns are named by the hash of their XML path
+	auto hash = [](const std::string &path) -> std::string {
+		SHA1 hasher;
+		hasher.addBytes(path);
+		return hasher.digest().asHex();
+	};
+	const auto longitude_column_hash = hash("/DataSets/DataSet/Units/Unit/Gathering/SiteCoordinateSets/SiteCoordinates/CoordinatesLatLong/LongitudeDecimal");
+	const auto latitude_column_hash = hash("/DataSets/DataSet/Units/Unit/Gathering/SiteCoordinateSets/SiteCoordinates/CoordinatesLatLong/LatitudeDecimal");
+	const auto unit_id_column_hash = hash("/DataSets/DataSet/Units/Unit/UnitID");
+
+	pqxx::connection connection{Configuration::get<std::string>("operators.abcdsource.dbcredentials")};
+	const auto schema = Configuration::get<std::string>("operators.abcdsource.schema");
+
+	const auto point = concat("ST_SetSRID(ST_MakePoint(\"", longitude_column_hash, "\", \"", latitude_column_hash, "\"), 4326)");
+
+	connection.prepare(
+			"abcd_tile",
+			concat(
+					"WITH bounds AS (SELECT ST_MakeEnvelope($2, $3, $4, $5, 3857) AS geom) ",
+					"SELECT ST_AsMVT(tile, 'units', 4096, 'geom') FROM (",
+					"SELECT ST_AsMVTGeom(ST_Transform(", point, ", 3857), bounds.geom, 4096, 64, true) AS geom, ",
+					"\"", unit_id_column_hash, "\" AS unit_id ",
+					"FROM ", schema, ".abcd_datasets JOIN ", schema, ".abcd_units USING(surrogate_key), bounds ",
+					"WHERE dataset_id = $1 ",
+					"AND \"", longitude_column_hash, "\" IS NOT NULL ",
+					"AND \"", latitude_column_hash, "\" IS NOT NULL ",
+					"AND ", point, " && ST_Transform(bounds.geom, 4326)",
+					") AS tile"
+			)
+	);
+
+	pqxx::work work(connection);
+	pqxx::result result = work.prepared("abcd_tile")(archive)(x1)(y1)(x2)(y2).exec();
+	work.commit();
+
+	return readTile(result);
+}
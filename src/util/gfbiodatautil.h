@@ -4,6 +4,10 @@
 #include "datatypes/spatiotemporal.h"
 
 #include <pqxx/pqxx>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
 
 
 class GFBioDataUtil {
@@ -12,6 +16,49 @@ public:
 	static std::string resolveTaxa(pqxx::connection &connection, std::string &term, std::string &level);
 	static std::string resolveTaxaNames(pqxx::connection &connection, std::string &term, std::string &level);
 
+	/**
+	 * Resolve the taxa of several (term, level) pairs in a single query
+	 * @return a map from each taxon to the index of the first pair that matches it
+	 */
+	static std::map<std::string, size_t> resolveTaxaOfTerms(pqxx::connection &connection, const std::vector<std::pair<std::string, std::string>> &terms);
+
+	/**
+	 * @param taxa postgres array of taxa
+	 * @return postgres array of the lower case names of the taxa
+	 */
+	static std::string resolveNamesOfTaxa(pqxx::connection &connection, const std::string &taxa);
+
+	/**
+	 * Record that a query requested the given set of `gbif.gbif` columns.
+	 * The usage is collected in memory and written in batches.
+	 */
+	static void logGBIFColumnUsage(pqxx::connection &connection, const std::vector<std::string> &columns);
+
+	/**
+	 * Find the narrowest projection of `gbif.gbif` that contains all given columns.
+	 * The projections are cached in memory and reloaded every minute.
+	 * @return the table name of the projection or an empty string if there is none
+	 */
+	static std::string findGBIFProjection(pqxx::connection &connection, const std::vector<std::string> &columns);
+
+	/**
+	 * Reload the projections with the next lookup, e.g. after a query on a dropped projection failed
+	 */
+	static void invalidateGBIFProjections();
+
+	/**
+	 * @return the columns of the projection for a set of hot columns: the columns that every query
+	 *         reads followed by the hot columns that are not among them
+	 */
+	static std::vector<std::string> getGBIFProjectionColumns(const std::vector<std::string> &hotColumns);
+
+	/**
+	 * Create, refresh and drop the projections of `gbif.gbif` according to the most frequently requested column sets
+	 * @param maxProjections the maximum number of projections to maintain
+	 * @return the table names of the current projections
+	 */
+	static std::vector<std::string> refreshGBIFProjections(size_t maxProjections);
+
 	static size_t countGBIFResults(std::string &term, std::string &level);
 
 	static size_t countIUCNResults(std::string &term, std::string &level);
@@ -20,6 +67,18 @@ public:
 
 	static Json::Value getGFBioDataCentersJSON();
 
+	/**
+	 * Encode the GBIF occurrences of a taxon within a web mercator tile as Mapbox Vector Tile
+	 * @return the encoded tile, empty if there are no occurrences
+	 */
+	static std::string getGBIFTile(std::string &term, std::string &level, int z, int x, int y);
+
+	/**
+	 * Encode the units of an ABCD archive within a web mercator tile as Mapbox Vector Tile
+	 * @return the encoded tile, empty if there are no units
+	 */
+	static std::string getABCDTile(const std::string &archive, int z, int x, int y);
+
 };
 
 
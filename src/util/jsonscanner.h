@@ -0,0 +1,191 @@
+#ifndef UTIL_JSONSCANNER_H_
+#define UTIL_JSONSCANNER_H_
+
+#include "util/concat.h"
+
+#include <stdexcept>
+#include <string>
+#include <json/json.h>
+
+/**
+ * Minimal pull scanner over a JSON text that skips values without materializing them
+ */
+class JsonScanner {
+	public:
+		explicit JsonScanner(const std::string &text) : text(text), position(0) {}
+
+		/**
+		 * call `member(key)` for every member of the object at the current position,
+		 * which has to consume the member's value
+		 */
+		template<typename Callback>
+		void forEachMember(Callback member) {
+			expect('{');
+			if(consume('}'))
+				return;
+			do {
+				std::string key = parseString();
+				expect(':');
+				member(key);
+			} while(consume(','));
+			expect('}');
+		}
+
+		/**
+		 * call `element()` for every element of the array at the current position,
+		 * which has to consume the element
+		 */
+		template<typename Callback>
+		void forEachElement(Callback element) {
+			expect('[');
+			if(consume(']'))
+				return;
+			do {
+				element();
+			} while(consume(','));
+			expect(']');
+		}
+
+		char peek() {
+			skipWhitespace();
+			if(position >= text.size())
+				throw std::runtime_error("JsonScanner: unexpected end of document");
+			return text[position];
+		}
+
+		std::string parseString() {
+			expect('"');
+			std::string result;
+			while(true) {
+				size_t end = text.find_first_of("\"\\", position);
+				if(end == std::string::npos)
+					throw std::runtime_error("JsonScanner: unterminated string");
+				result.append(text, position, end - position);
+				position = end + 1;
+				if(text[end] == '"')
+					return result;
+				parseEscape(result);
+			}
+		}
+
+		/**
+		 * parse the value at the current position into a DOM
+		 */
+		Json::Value parseValue() {
+			skipWhitespace();
+			size_t begin = position;
+			skipValue();
+
+			Json::Reader reader;
+			Json::Value value;
+			if(!reader.parse(text.data() + begin, text.data() + position, value, false))
+				throw std::runtime_error("JsonScanner: invalid value");
+			return value;
+		}
+
+		void skipValue() {
+			char c = peek();
+			if(c == '"') {
+				parseString();
+			} else if(c == '{') {
+				forEachMember([this](const std::string &) { skipValue(); });
+			} else if(c == '[') {
+				forEachElement([this]() { skipValue(); });
+			} else {
+				// number, true, false or null
+				size_t end = text.find_first_of(",}] \t\r\n", position);
+				if(end == position)
+					throw std::runtime_error("JsonScanner: invalid value");
+				position = end == std::string::npos ? text.size() : end;
+			}
+		}
+
+		void expectEnd() {
+			skipWhitespace();
+			if(position != text.size())
+				throw std::runtime_error("JsonScanner: trailing characters");
+		}
+
+	private:
+		void skipWhitespace() {
+			while(position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r'))
+				++position;
+		}
+
+		bool consume(char c) {
+			if(peek() != c)
+				return false;
+			++position;
+			return true;
+		}
+
+		void expect(char c) {
+			if(!consume(c))
+				throw std::runtime_error(concat("JsonScanner: expected ", c, " at ", position));
+		}
+
+		unsigned int parseHex() {
+			if(position + 4 > text.size())
+				throw std::runtime_error("JsonScanner: invalid unicode escape");
+			unsigned int code = 0;
+			for(size_t end = position + 4; position < end; ++position) {
+				char c = text[position];
+				code <<= 4;
+				if(c >= '0' && c <= '9')
+					code |= c - '0';
+				else if(c >= 'a' && c <= 'f')
+					code |= c - 'a' + 10;
+				else if(c >= 'A' && c <= 'F')
+					code |= c - 'A' + 10;
+				else
+					throw std::runtime_error("JsonScanner: invalid unicode escape");
+			}
+			return code;
+		}
+
+		void parseEscape(std::string &result) {
+			if(position >= text.size())
+				throw std::runtime_error("JsonScanner: unterminated string");
+			char c = text[position++];
+			switch(c) {
+				case 'b': result += '\b'; break;
+				case 'f': result += '\f'; break;
+				case 'n': result += '\n'; break;
+				case 'r': result += '\r'; break;
+				case 't': result += '\t'; break;
+				case 'u': {
+					unsigned int code = parseHex();
+					if(code >= 0xD800 && code <= 0xDBFF && text.compare(position, 2, "\\u") == 0) {
+						position += 2;
+						code = 0x10000 + ((code - 0xD800) << 10) + (parseHex() - 0xDC00);
+					}
+					appendUTF8(result, code);
+					break;
+				}
+				default: result += c; break;
+			}
+		}
+
+		static void appendUTF8(std::string &result, unsigned int code) {
+			if(code < 0x80) {
+				result += static_cast<char>(code);
+			} else if(code < 0x800) {
+				result += static_cast<char>(0xC0 | (code >> 6));
+				result += static_cast<char>(0x80 | (code & 0x3F));
+			} else if(code < 0x10000) {
+				result += static_cast<char>(0xE0 | (code >> 12));
+				result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+				result += static_cast<char>(0x80 | (code & 0x3F));
+			} else {
+				result += static_cast<char>(0xF0 | (code >> 18));
+				result += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+				result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+				result += static_cast<char>(0x80 | (code & 0x3F));
+			}
+		}
+
+		const std::string &text;
+		size_t position;
+};
+
+#endif /* UTIL_JSONSCANNER_H_ */
@@ -0,0 +1,108 @@
+#ifndef UTIL_LRUCACHE_H_
+#define UTIL_LRUCACHE_H_
+
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * A thread-safe, size bounded key-value cache with least-recently-used eviction.
+ * Entries optionally expire after a time-to-live.
+ */
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class LRUCache {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        /**
+         * @param capacity maximum number of entries, 0 disables the cache
+         * @param ttl time after which an entry expires, zero for no expiration
+         */
+        explicit LRUCache(size_t capacity, std::chrono::seconds ttl = std::chrono::seconds::zero())
+                : capacity(capacity), ttl(ttl) {}
+
+        /**
+         * Look up an entry and mark it as recently used
+         * @return true iff a valid entry was found and copied to `value`
+         */
+        bool get(const Key &key, Value &value) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto it = index.find(key);
+            if (it == index.end()) {
+                return false;
+            }
+
+            if (isExpired(*it->second)) {
+                entries.erase(it->second);
+                index.erase(it);
+                return false;
+            }
+
+            entries.splice(entries.begin(), entries, it->second);
+            value = it->second->value;
+            return true;
+        }
+
+        /**
+         * Insert or replace an entry, evicting the least recently used entries if necessary
+         */
+        void put(const Key &key, Value value) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (capacity == 0) {
+                return;
+            }
+
+            auto it = index.find(key);
+            if (it != index.end()) {
+                entries.erase(it->second);
+                index.erase(it);
+            }
+
+            entries.push_front(Entry{key, std::move(value), clock::now()});
+            index[key] = entries.begin();
+
+            while (entries.size() > capacity) {
+                index.erase(entries.back().key);
+                entries.pop_back();
+            }
+        }
+
+        void remove(const Key &key) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto it = index.find(key);
+            if (it != index.end()) {
+                entries.erase(it->second);
+                index.erase(it);
+            }
+        }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return entries.size();
+        }
+
+    private:
+        struct Entry {
+            Key key;
+            Value value;
+            clock::time_point inserted;
+        };
+
+        bool isExpired(const Entry &entry) const {
+            return ttl != std::chrono::seconds::zero() && clock::now() - entry.inserted > ttl;
+        }
+
+        const size_t capacity;
+        const std::chrono::seconds ttl;
+
+        std::list<Entry> entries;
+        std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index;
+
+        mutable std::mutex mutex;
+};
+
+#endif /* UTIL_LRUCACHE_H_ */
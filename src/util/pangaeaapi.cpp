@@ -1,46 +1,62 @@
 #include <algorithm>
+#include <future>
+#include <stdexcept>
+#include <map>
+#include <memory>
+#include <mutex>
 #include "pangaeaapi.h"
 
 #include "util/concat.h"
 #include "util/stringsplit.h"
 #include "util/curl.h"
+#include "util/curlpool.h"
 #include "util/configuration.h"
 #include "util/exceptions.h"
+#include "util/log.h"
+#include "util/lrucache.h"
+#include "util/pangaeacache.h"
+#include "util/jsonscanner.h"
 
-PangaeaAPI::Parameter::Parameter(const Json::Value &json, const std::vector<Parameter> &parameters) {
-	name = json.get("name", "").asString();
-	if(json.isMember("description")) {
-		name += " " + json.get("description", "").asString();
-	}
+static std::chrono::seconds metaDataTTL() {
+	return std::chrono::seconds(Configuration::get<long>("pangaea.metadata.ttl", 3600));
+}
+
+static LRUCache<std::string, std::shared_ptr<const PangaeaAPI::MetaData>> &metaDataCache() {
+	static LRUCache<std::string, std::shared_ptr<const PangaeaAPI::MetaData>> cache(
+			Configuration::get<size_t>("pangaea.metadata.capacity", 1024), metaDataTTL());
+	return cache;
+}
 
-	handleNameCollision(parameters);
+static LRUCache<std::string, std::string> &citationCache() {
+	static LRUCache<std::string, std::string> cache(
+			Configuration::get<size_t>("pangaea.metadata.capacity", 1024), metaDataTTL());
+	return cache;
+}
+
+PangaeaAPI::Parameter::Parameter(const std::string &name, bool hasDescription, const std::string &description,
+								 const std::string &unit, std::unordered_set<std::string> &usedNames)
+		: name(name), unit(unit), numeric(!unit.empty()) {
+	if(hasDescription) {
+		this->name += " " + description;
+	}
 
-	unit = json.get("unitText", "").asString();
-	numeric = unit != "";
+	handleNameCollision(usedNames);
 }
 
-void PangaeaAPI::Parameter::handleNameCollision(const std::vector<PangaeaAPI::Parameter> &parameters) {
+void PangaeaAPI::Parameter::handleNameCollision(std::unordered_set<std::string> &usedNames) {
 	std::string originalName = this->name;
 	size_t counter = 1;
-	bool collision;
-	do {
-		auto it = find_if(parameters.begin(), parameters.end(),
-												 [this](const PangaeaAPI::Parameter & p) -> bool { return p.name ==
-																									  this->name;});
-
-		collision = it != parameters.end();
-		if(collision) {
-			this->name = concat(originalName, counter++);
+	while(usedNames.count(this->name) > 0) {
+		if(counter >= 1000) {
+			throw MustNotHappenException("Pangaea Parameter name collision could not be resolved");
 		}
-
-	} while (collision && counter < 1000);
-
-	if(collision) {
-		throw MustNotHappenException("Pangaea Parameter name collision could not be resolved");
+		this->name = concat(originalName, counter++);
 	}
+
+	usedNames.insert(this->name);
 }
 
-Json::Value PangaeaAPI::Parameter::toJson() {
+Json::Value PangaeaAPI::Parameter::toJson() const {
 	Json::Value json(Json::objectValue);
 	json["name"] = name;
 	json["unit"] = unit;
@@ -50,30 +66,85 @@ Json::Value PangaeaAPI::Parameter::toJson() {
 
 std::vector<PangaeaAPI::Parameter> PangaeaAPI::parseParameters(const Json::Value &json) {
 	std::vector<PangaeaAPI::Parameter> parameters;
+	std::unordered_set<std::string> usedNames;
 	for(auto &parameter: json.get("variableMeasured", Json::Value(Json::arrayValue))) {
-		parameters.emplace_back(parameter, parameters);
+		const bool hasDescription = parameter.isMember("description");
+		std::string description = hasDescription ? parameter.get("description", "").asString() : "";
+		parameters.emplace_back(parameter.get("name", "").asString(), hasDescription, description,
+								parameter.get("unitText", "").asString(), usedNames);
 	}
 	return parameters;
 }
 
-Json::Value PangaeaAPI::getMetaDataFromPangaea(const std::string &dataSetDOI) {
-	// get parameters from pangae
+std::string PangaeaAPI::downloadDocument(const std::string &dataSetDOI, const std::string &format) {
 	std::stringstream data;
-	cURL curl;
+	auto curl = cURLPool::acquire();
 	curl.setOpt(CURLOPT_PROXY, Configuration::get<std::string>("proxy", "").c_str());
-	curl.setOpt(CURLOPT_URL, concat("https://doi.pangaea.de/", dataSetDOI, "?format=metadata_jsonld").c_str());
+	curl.setOpt(CURLOPT_URL, concat("https://doi.pangaea.de/", dataSetDOI, "?format=", format).c_str());
 	curl.setOpt(CURLOPT_WRITEFUNCTION, cURL::defaultWriteFunction);
 	curl.setOpt(CURLOPT_WRITEDATA, &data);
+	curl.perform();
 
+	return data.str();
+}
+
+std::string PangaeaAPI::fetchDocument(const std::string &dataSetDOI, const std::string &format) {
+	const bool diskCache = PangaeaCache::isEnabled();
+
+	std::string document;
+	if(diskCache && PangaeaCache::getDocument(dataSetDOI, format, metaDataTTL().count(), document))
+		return document;
+
+	static std::mutex mutex;
+	static std::map<std::string, std::shared_future<std::string>> downloads;
+
+	const std::string key = concat(format, "/", dataSetDOI);
+	std::shared_future<std::string> download;
+	bool owner = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = downloads.find(key);
+		if(it != downloads.end()) {
+			download = it->second;
+		} else {
+			download = std::async(std::launch::deferred, &PangaeaAPI::downloadDocument, dataSetDOI, format).share();
+			downloads[key] = download;
+			owner = true;
+		}
+	}
+
+	if(!owner)
+		return download.get();
+
+	// the owner runs the deferred download, everybody else waits for it
 	try {
-		curl.perform();
+		document = download.get();
+	} catch (...) {
+		std::lock_guard<std::mutex> lock(mutex);
+		downloads.erase(key);
+		throw;
+	}
+
+	if(diskCache)
+		PangaeaCache::putDocument(dataSetDOI, format, document);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	downloads.erase(key);
+
+	return document;
+}
+
+Json::Value PangaeaAPI::getMetaDataFromPangaea(const std::string &dataSetDOI) {
+	std::string data;
+	try {
+		data = fetchDocument(dataSetDOI, "metadata_jsonld");
 	} catch (const cURLException&) {
 		throw std::runtime_error(concat("PangaeaAPI: could not retrieve metadata from pangaea doi ", dataSetDOI));
 	}
 
 	Json::Reader reader(Json::Features::strictMode());
 	Json::Value jsonResponse;
-	if (!reader.parse(data.str(), jsonResponse))
+	if (!reader.parse(data, jsonResponse))
 		throw std::runtime_error(concat("PangaeaAPI: could not parse metadata from pangaea dataset ", dataSetDOI));
 
 	return jsonResponse;
@@ -102,6 +173,10 @@ void PangaeaAPI::MetaData::initSpatialCoverage(const Json::Value &json) {
             }
 
             spatialCoverageType = SpatialCoverageType::BOX;
+            spatialCoverageX1 = x1;
+            spatialCoverageY1 = y1;
+            spatialCoverageX2 = x2;
+            spatialCoverageY2 = y2;
             spatialCoverageWKT = concat("POLYGON((", x1, " ", y1, ",", x1, " ", y2, ",", x2, " ", y2, ",", x2, " ", y1,
                                         ",", x1, " ", y1, "))");
         } else if (geo.get("@type", "").asString() == "GeoCoordinates") {
@@ -109,6 +184,8 @@ void PangaeaAPI::MetaData::initSpatialCoverage(const Json::Value &json) {
             double lat = geo.get("latitude", 0.0).asDouble();
 
             spatialCoverageType = SpatialCoverageType::POINT;
+            spatialCoverageX1 = spatialCoverageX2 = lon;
+            spatialCoverageY1 = spatialCoverageY2 = lat;
             spatialCoverageWKT = concat("POINT(", lon, " ", lat, ")");
         } else {
             spatialCoverageType = SpatialCoverageType::NONE;
@@ -138,6 +215,67 @@ PangaeaAPI::MetaData::MetaData(const Json::Value &json): parameters(parseParamet
     parseFormat(json);
 }
 
+/**
+ * @return the value at the current position as string, like `Json::Value::asString` but empty for non-scalars
+ */
+static std::string scanString(JsonScanner &scanner) {
+	if(scanner.peek() == '"')
+		return scanner.parseString();
+
+	Json::Value value = scanner.parseValue();
+	return value.isConvertibleTo(Json::stringValue) ? value.asString() : "";
+}
+
+PangaeaAPI::MetaData PangaeaAPI::MetaData::fromJsonLD(const std::string &document) {
+	static const std::unordered_set<std::string> members = {
+			"spatialCoverage", "license", "url", "creator", "name", "distribution"
+	};
+
+	Json::Value selected(Json::objectValue);
+	std::vector<Parameter> parameters;
+	std::unordered_set<std::string> usedNames;
+
+	JsonScanner scanner(document);
+	scanner.forEachMember([&](const std::string &key) {
+		if(key == "variableMeasured" && scanner.peek() == '[') {
+			parameters.clear();
+			usedNames.clear();
+			scanner.forEachElement([&]() {
+				if(scanner.peek() != '{') {
+					scanner.skipValue();
+					parameters.emplace_back("", false, "", "", usedNames);
+					return;
+				}
+
+				std::string name, description, unit;
+				bool hasDescription = false;
+				scanner.forEachMember([&](const std::string &parameterKey) {
+					if(parameterKey == "name")
+						name = scanString(scanner);
+					else if(parameterKey == "description") {
+						description = scanString(scanner);
+						hasDescription = true;
+					}
+					else if(parameterKey == "unitText")
+						unit = scanString(scanner);
+					else
+						scanner.skipValue();
+				});
+				parameters.emplace_back(name, hasDescription, description, unit, usedNames);
+			});
+		} else if(members.count(key) > 0) {
+			selected[key] = scanner.parseValue();
+		} else {
+			scanner.skipValue();
+		}
+	});
+	scanner.expectEnd();
+
+	MetaData metaData(selected);
+	metaData.parameters = std::move(parameters);
+	return metaData;
+}
+
 void PangaeaAPI::MetaData::parseFormat(const Json::Value &json) {
     Json::Value distribution = json.get("distribution", Json::Value(Json::arrayValue));
 
@@ -162,32 +300,48 @@ void PangaeaAPI::MetaData::parseFormat(const Json::Value &json) {
 }
 
 
-PangaeaAPI::MetaData PangaeaAPI::getMetaData(const std::string &dataSetDOI) {
-	Json::Value json = PangaeaAPI::getMetaDataFromPangaea(dataSetDOI);
+std::shared_ptr<const PangaeaAPI::MetaData> PangaeaAPI::getMetaData(const std::string &dataSetDOI) {
+	std::shared_ptr<const PangaeaAPI::MetaData> cached;
+	if(metaDataCache().get(dataSetDOI, cached))
+		return cached;
+
+	std::string document;
+	try {
+		document = fetchDocument(dataSetDOI, "metadata_jsonld");
+	} catch (const cURLException&) {
+		throw std::runtime_error(concat("PangaeaAPI: could not retrieve metadata from pangaea doi ", dataSetDOI));
+	}
 
-	PangaeaAPI::MetaData metaData(json);
+	std::shared_ptr<const PangaeaAPI::MetaData> metaData;
+	try {
+		metaData = std::make_shared<const PangaeaAPI::MetaData>(MetaData::fromJsonLD(document));
+	} catch (const std::runtime_error&) {
+		throw std::runtime_error(concat("PangaeaAPI: could not parse metadata from pangaea dataset ", dataSetDOI));
+	}
+	metaDataCache().put(dataSetDOI, metaData);
 
 	return metaData;
 }
 
 std::string PangaeaAPI::getCitation(const std::string &dataSetDOI) {
-	// get parameters from pangaea
-	std::stringstream data;
-	cURL curl;
-	curl.setOpt(CURLOPT_PROXY, Configuration::get<std::string>("proxy", "").c_str());
-	curl.setOpt(CURLOPT_URL, concat("https://doi.pangaea.de/", dataSetDOI, "?format=citation_text").c_str());
-	curl.setOpt(CURLOPT_WRITEFUNCTION, cURL::defaultWriteFunction);
-	curl.setOpt(CURLOPT_WRITEDATA, &data);
+	std::string citation;
+	if(citationCache().get(dataSetDOI, citation))
+		return citation;
 
 	try {
-		curl.perform();
+		citation = fetchDocument(dataSetDOI, "citation_text");
 	} catch (const cURLException&) {
 		throw std::runtime_error("PangaeaAPI: could not retrieve citation from pangaea");
 	}
 
-	return data.str();
+	citationCache().put(dataSetDOI, citation);
+
+	return citation;
 }
 
+std::string PangaeaAPI::getDataUrl(const std::string &dataSetDOI) {
+	return concat("https://doi.pangaea.de/", dataSetDOI, "?format=textfile");
+}
 
 bool PangaeaAPI::Parameter::isLongitudeColumn() const {
 	return name == "LONGITUDE" || name.find("Longitude") == 0;
@@ -1,6 +1,9 @@
 #ifndef UTIL_PANGAEAAPI_H_
 #define UTIL_PANGAEAAPI_H_
 
+#include <memory>
+#include <string>
+#include <unordered_set>
 #include <vector>
 #include <json/json.h>
 
@@ -13,7 +16,13 @@ public:
 
 	class Parameter {
 	public:
-        Parameter(const Json::Value &json, const std::vector<Parameter> &parameters);
+		/**
+		 * @param hasDescription whether the parameter has a description member, even an empty one,
+		 *        which is then appended to the name after a space
+		 * @param usedNames names of the existing parameters, the name of this parameter is added
+		 */
+		Parameter(const std::string &name, bool hasDescription, const std::string &description,
+				  const std::string &unit, std::unordered_set<std::string> &usedNames);
 
         std::string name;
 		std::string unit;
@@ -22,13 +31,13 @@ public:
 		bool isLongitudeColumn() const;
 		bool isLatitudeColumn() const;
 
-		Json::Value toJson();
+		Json::Value toJson() const;
 
 		/**
-		 * resolve name collisions with existing parameters
-		 * @param parameters
+		 * resolve name collisions with a set of used names in constant time per candidate name
+		 * and add the final name to the set
 		 */
-		void handleNameCollision(const std::vector<Parameter> &parameters);
+		void handleNameCollision(std::unordered_set<std::string> &usedNames);
 	};
 
 
@@ -36,6 +45,12 @@ public:
 	public:
 		explicit MetaData(const Json::Value &json);
 
+		/**
+		 * Extract the metadata from a JSON-LD document without building a DOM of the whole document.
+		 * Only the members used by `MetaData` are parsed, the parameters are read directly from the text.
+		 */
+		static MetaData fromJsonLD(const std::string &document);
+
 		enum class SpatialCoverageType {
 			NONE, BOX, POINT
 		};
@@ -49,6 +64,8 @@ public:
 		std::vector<Parameter> parameters;
 		std::string spatialCoverageWKT;
 		SpatialCoverageType spatialCoverageType;
+		/// bounds of the spatial coverage, both corners are equal for a point
+		double spatialCoverageX1 = 0, spatialCoverageY1 = 0, spatialCoverageX2 = 0, spatialCoverageY2 = 0;
 
 		std::string license;
 		std::string url;
@@ -58,16 +75,36 @@ public:
         void parseFormat(const Json::Value &json);
     };
 
-	static MetaData getMetaData(const std::string &dataSetDOI);
+	/**
+	 * Get the metadata of a data set. Results are cached process-wide for `pangaea.metadata.ttl` seconds
+	 * and, if the Pangaea cache is enabled, on disk. Cached metadata is shared between callers, not copied.
+	 */
+	static std::shared_ptr<const MetaData> getMetaData(const std::string &dataSetDOI);
 
+	/**
+	 * Get the citation of a data set, cached like its metadata
+	 */
 	static std::string getCitation(const std::string &dataSetDOI);
 
+	/**
+	 * @return the url of the tab separated textfile of a data set
+	 */
+	static std::string getDataUrl(const std::string &dataSetDOI);
+
     static Json::Value getMetaDataFromPangaea(const std::string &dataSetDOI);
 
 private:
 
     static std::vector<Parameter> parseParameters(const Json::Value &json);
 
+	/**
+	 * Get a document of a data set from the disk cache or the server.
+	 * Concurrent requests for the same document share a single download.
+	 */
+	static std::string fetchDocument(const std::string &dataSetDOI, const std::string &format);
+
+	static std::string downloadDocument(const std::string &dataSetDOI, const std::string &format);
+
 
 };
 
@@ -0,0 +1,355 @@
+#include "pangaeacache.h"
+
+#include "util/pangaeaapi.h"
+#include "util/pangaeatable.h"
+#include "util/configuration.h"
+#include "util/concat.h"
+#include "util/exceptions.h"
+#include "util/log.h"
+#include "util/curlpool.h"
+#include "util/sha1.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <curl/curl.h>
+#include <dirent.h>
+#include <fstream>
+#include <json/json.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#include <vector>
+
+/**
+ * serializes the downloads of a data set within this process
+ */
+static std::mutex &dataSetMutex(const std::string &dataSetDOI) {
+	static std::mutex mutex;
+	static std::map<std::string, std::unique_ptr<std::mutex>> dataSetMutexes;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto &dataSetMutex = dataSetMutexes[dataSetDOI];
+	if(!dataSetMutex)
+		dataSetMutex = std::make_unique<std::mutex>();
+	return *dataSetMutex;
+}
+
+bool PangaeaCache::isEnabled() {
+	return !Configuration::get<std::string>("pangaea.cache.directory", "").empty();
+}
+
+std::string PangaeaCache::basePath(const std::string &dataSetDOI) {
+	SHA1 hasher;
+	hasher.addBytes(dataSetDOI);
+	return concat(Configuration::get<std::string>("pangaea.cache.directory"), "/", hasher.digest().asHex());
+}
+
+bool PangaeaCache::readEntry(const std::string &path, PangaeaCache::Entry &entry) {
+	std::ifstream file(path);
+	if(!file)
+		return false;
+
+	Json::Reader reader(Json::Features::strictMode());
+	Json::Value json;
+	if(!reader.parse(file, json))
+		return false;
+
+	entry.doi = json.get("doi", "").asString();
+	entry.etag = json.get("etag", "").asString();
+	entry.lastModified = json.get("last_modified", "").asString();
+	entry.fetched = static_cast<std::time_t>(json.get("fetched", 0).asInt64());
+	return true;
+}
+
+void PangaeaCache::writeEntry(const std::string &path, const PangaeaCache::Entry &entry) {
+	Json::Value json(Json::objectValue);
+	json["doi"] = entry.doi;
+	json["etag"] = entry.etag;
+	json["last_modified"] = entry.lastModified;
+	json["fetched"] = static_cast<Json::Int64>(entry.fetched);
+
+	std::string temporaryPath = concat(path, ".", getpid(), ".tmp");
+	{
+		std::ofstream file(temporaryPath, std::ios::trunc);
+		file << json;
+	}
+	std::rename(temporaryPath.c_str(), path.c_str());
+}
+
+/**
+ * collects the validators of a response
+ */
+static size_t headerFunction(char *buffer, size_t size, size_t nitems, void *userdata) {
+	auto headers = reinterpret_cast<std::map<std::string, std::string> *>(userdata);
+	std::string line(buffer, size * nitems);
+
+	size_t colon = line.find(':');
+	if(colon != std::string::npos) {
+		std::string name = line.substr(0, colon);
+		std::string value = line.substr(colon + 1);
+		value.erase(0, value.find_first_not_of(" \t"));
+		value.erase(value.find_last_not_of(" \t\r\n") + 1);
+
+		if(strcasecmp(name.c_str(), "ETag") == 0)
+			(*headers)["etag"] = value;
+		else if(strcasecmp(name.c_str(), "Last-Modified") == 0)
+			(*headers)["last_modified"] = value;
+	}
+
+	return size * nitems;
+}
+
+static size_t fileWriteFunction(char *ptr, size_t size, size_t nmemb, void *userdata) {
+	auto file = reinterpret_cast<std::ofstream *>(userdata);
+	file->write(ptr, size * nmemb);
+	return *file ? size * nmemb : 0;
+}
+
+bool PangaeaCache::download(const std::string &dataPath, PangaeaCache::Entry &entry) {
+	std::string temporaryPath = concat(dataPath, ".", getpid(), ".tmp");
+	std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+	if(!file)
+		throw cURLException(concat("PangaeaCache: could not create file ", temporaryPath));
+
+	auto curl = cURLPool::acquire();
+	std::unique_ptr<curl_slist, decltype(&curl_slist_free_all)> requestHeaders(nullptr, curl_slist_free_all);
+
+	if(!entry.etag.empty())
+		requestHeaders.reset(curl_slist_append(requestHeaders.release(), concat("If-None-Match: ", entry.etag).c_str()));
+	if(!entry.lastModified.empty())
+		requestHeaders.reset(curl_slist_append(requestHeaders.release(), concat("If-Modified-Since: ", entry.lastModified).c_str()));
+
+	std::map<std::string, std::string> responseHeaders;
+	char errorBuffer[CURL_ERROR_SIZE] = {};
+	const std::string url = PangaeaAPI::getDataUrl(entry.doi);
+
+	curl_easy_setopt(curl.get(), CURLOPT_PROXY, Configuration::get<std::string>("proxy", "").c_str());
+	curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
+	curl_easy_setopt(curl.get(), CURLOPT_FAILONERROR, 1L);
+	curl_easy_setopt(curl.get(), CURLOPT_ERRORBUFFER, errorBuffer);
+	curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, requestHeaders.get());
+	curl_easy_setopt(curl.get(), CURLOPT_HEADERFUNCTION, headerFunction);
+	curl_easy_setopt(curl.get(), CURLOPT_HEADERDATA, &responseHeaders);
+	curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, fileWriteFunction);
+	curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &file);
+
+	CURLcode result = curl_easy_perform(curl.get());
+	long responseCode = 0;
+	curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &responseCode);
+
+	file.close();
+
+	if(result != CURLE_OK || !file) {
+		std::remove(temporaryPath.c_str());
+		throw cURLException(concat("PangaeaCache: could not download data set ", entry.doi, ": ",
+								   errorBuffer[0] != '\0' ? errorBuffer : curl_easy_strerror(result)));
+	}
+
+	if(responseCode == 304) {
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+
+	if(std::rename(temporaryPath.c_str(), dataPath.c_str()) != 0) {
+		std::remove(temporaryPath.c_str());
+		throw cURLException(concat("PangaeaCache: could not store data set ", entry.doi));
+	}
+
+	entry.etag = responseHeaders["etag"];
+	entry.lastModified = responseHeaders["last_modified"];
+
+	return true;
+}
+
+std::string PangaeaCache::getTextfile(const std::string &dataSetDOI) {
+	std::lock_guard<std::mutex> lock(dataSetMutex(dataSetDOI));
+
+	const std::string base = basePath(dataSetDOI);
+	const std::string dataPath = base + ".tsv";
+	const std::string entryPath = base + ".json";
+
+	Entry entry;
+	bool cached = readEntry(entryPath, entry) && entry.doi == dataSetDOI && access(dataPath.c_str(), R_OK) == 0;
+
+	const std::time_t now = std::time(nullptr);
+	if(cached && now - entry.fetched < Configuration::get<long>("pangaea.cache.ttl", 3600)) {
+		utime(entryPath.c_str(), nullptr); // mark as recently used
+		return dataPath;
+	}
+
+	if(!cached) {
+		entry = Entry();
+		entry.doi = dataSetDOI;
+	}
+
+	bool modified;
+	try {
+		modified = download(dataPath, entry);
+	} catch (const cURLException &e) {
+		if(!cached)
+			throw;
+
+		Log::warn(concat("PangaeaCache: could not revalidate ", dataSetDOI, ", using cached copy: ", e.what()));
+		return dataPath;
+	}
+
+	entry.fetched = now;
+	writeEntry(entryPath, entry);
+
+	if(modified)
+		evict();
+
+	return dataPath;
+}
+
+std::string PangaeaCache::getColumnarFile(const std::string &dataSetDOI, const PangaeaAPI::MetaData &metaData) {
+	const std::string textfilePath = getTextfile(dataSetDOI);
+
+	std::lock_guard<std::mutex> lock(dataSetMutex(dataSetDOI));
+
+	const std::string columnarPath = basePath(dataSetDOI) + ".col";
+
+	struct stat status{};
+	if(stat(textfilePath.c_str(), &status) != 0)
+		throw OperatorException(concat("PangaeaCache: cached data set ", dataSetDOI, " vanished"));
+
+	if(PangaeaColumnarFile::isUpToDate(columnarPath, status.st_size, status.st_mtime, metaData.parameters))
+		return columnarPath;
+
+	// the table of all columns holds at least the whole text
+	const long long memoryLimit = Configuration::get<long long>("pangaea.memory.max", 2048) * 1024 * 1024;
+	if(memoryLimit > 0 && status.st_size > memoryLimit) {
+		Log::info(concat("PangaeaCache: data set ", dataSetDOI, " is too large for a columnar file"));
+		return "";
+	}
+
+	std::ifstream textfile(textfilePath, std::ios::binary);
+	PangaeaTable::skipTextfileHeader(textfile);
+
+	PangaeaTable table(metaData.parameters);
+	table.parse(textfile);
+
+	if(textfile.bad())
+		throw OperatorException(concat("PangaeaCache: could not read cached data set ", dataSetDOI));
+
+	std::string temporaryPath = concat(columnarPath, ".", getpid(), ".tmp");
+	try {
+		table.write(temporaryPath, status.st_size, status.st_mtime);
+	} catch (const OperatorException &) {
+		std::remove(temporaryPath.c_str());
+		throw;
+	}
+
+	if(std::rename(temporaryPath.c_str(), columnarPath.c_str()) != 0) {
+		std::remove(temporaryPath.c_str());
+		throw OperatorException(concat("PangaeaCache: could not store columnar file of ", dataSetDOI));
+	}
+
+	return columnarPath;
+}
+
+bool PangaeaCache::getDocument(const std::string &dataSetDOI, const std::string &name, long ttl, std::string &document) {
+	const std::string path = concat(basePath(dataSetDOI), ".", name);
+
+	struct stat status{};
+	if(stat(path.c_str(), &status) != 0 || std::time(nullptr) - status.st_mtime > ttl)
+		return false;
+
+	std::ifstream file(path, std::ios::binary);
+	if(!file)
+		return false;
+
+	std::stringstream data;
+	data << file.rdbuf();
+	document = data.str();
+	return true;
+}
+
+void PangaeaCache::putDocument(const std::string &dataSetDOI, const std::string &name, const std::string &document) {
+	const std::string path = concat(basePath(dataSetDOI), ".", name);
+	const std::string temporaryPath = concat(path, ".", getpid(), ".tmp");
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		file << document;
+		if(!file) {
+			std::remove(temporaryPath.c_str());
+			Log::warn(concat("PangaeaCache: could not store ", name, " of ", dataSetDOI));
+			return;
+		}
+	}
+	std::rename(temporaryPath.c_str(), path.c_str());
+}
+
+void PangaeaCache::evict() {
+	const std::string directory = Configuration::get<std::string>("pangaea.cache.directory");
+	const long long maxSize = Configuration::get<long long>("pangaea.cache.max_size", 4096) * 1024 * 1024;
+	const std::time_t now = std::time(nullptr);
+
+	// all files of a data set share the hash of its DOI as prefix
+	struct DataSet {
+		std::time_t lastUsed = 0;
+		long long size = 0;
+		std::vector<std::string> files;
+	};
+	std::map<std::string, DataSet> dataSets;
+	long long totalSize = 0;
+
+	DIR *dir = opendir(directory.c_str());
+	if(dir == nullptr)
+		return;
+
+	while(struct dirent *file = readdir(dir)) {
+		std::string name = file->d_name;
+		if(name == "." || name == "..")
+			continue;
+
+		std::string path = concat(directory, "/", name);
+		struct stat status{};
+		if(stat(path.c_str(), &status) != 0 || !S_ISREG(status.st_mode))
+			continue;
+
+		// leftovers of interrupted downloads
+		if(name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+			if(now - status.st_mtime > 24 * 60 * 60)
+				std::remove(path.c_str());
+			continue;
+		}
+
+		auto &dataSet = dataSets[name.substr(0, name.find('.'))];
+		dataSet.size += status.st_size;
+		dataSet.files.push_back(path);
+		if(name.find(".json") != std::string::npos)
+			dataSet.lastUsed = status.st_mtime;
+
+		totalSize += status.st_size;
+	}
+	closedir(dir);
+
+	if(totalSize <= maxSize)
+		return;
+
+	std::vector<DataSet *> leastRecentlyUsed;
+	for(auto &dataSet : dataSets)
+		leastRecentlyUsed.push_back(&dataSet.second);
+	std::sort(leastRecentlyUsed.begin(), leastRecentlyUsed.end(), [](const DataSet *a, const DataSet *b) {
+		return a->lastUsed < b->lastUsed;
+	});
+
+	for(auto dataSet : leastRecentlyUsed) {
+		if(totalSize <= maxSize)
+			break;
+
+		// keep data sets that might currently be read
+		if(now - dataSet->lastUsed < 60)
+			continue;
+
+		for(auto &path : dataSet->files)
+			std::remove(path.c_str());
+		totalSize -= dataSet->size;
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef UTIL_PANGAEACACHE_H_
+#define UTIL_PANGAEACACHE_H_
+
+#include "util/pangaeaapi.h"
+
+#include <ctime>
+#include <string>
+
+/**
+ * Persistent on-disk cache for the textfiles of Pangaea data sets.
+ *
+ * Files are stored in `pangaea.cache.directory`, keyed by DOI. Within `pangaea.cache.ttl` seconds
+ * a cached file is used as is, afterwards it is revalidated with a conditional GET (`ETag`, `Last-Modified`).
+ * The least recently used files are evicted when the cache exceeds `pangaea.cache.max_size` MiB.
+ *
+ * Next to a textfile, the cache keeps its columnar representation (see `PangaeaColumnarFile`)
+ * and small documents like its metadata and citation.
+ */
+class PangaeaCache {
+public:
+	/**
+	 * @return true iff a cache directory is configured
+	 */
+	static bool isEnabled();
+
+	/**
+	 * Get the path of an up to date local copy of the textfile of a data set.
+	 * The file is downloaded or revalidated if necessary.
+	 */
+	static std::string getTextfile(const std::string &dataSetDOI);
+
+	/**
+	 * Get the path of the columnar file of an up to date textfile of a data set.
+	 * The textfile is converted on first access and whenever it changed.
+	 * @return an empty string if the textfile is too large to be converted within `pangaea.memory.max`
+	 */
+	static std::string getColumnarFile(const std::string &dataSetDOI, const PangaeaAPI::MetaData &metaData);
+
+	/**
+	 * Look up a document of a data set that was stored at most `ttl` seconds ago
+	 * @param name the kind of document, e.g. "metadata"
+	 * @return true iff the document was found and copied to `document`
+	 */
+	static bool getDocument(const std::string &dataSetDOI, const std::string &name, long ttl, std::string &document);
+
+	/**
+	 * Store a document of a data set
+	 */
+	static void putDocument(const std::string &dataSetDOI, const std::string &name, const std::string &document);
+
+private:
+	class Entry {
+	public:
+		std::string doi;
+		std::string etag;
+		std::string lastModified;
+		std::time_t fetched = 0;
+	};
+
+	static std::string basePath(const std::string &dataSetDOI);
+
+	static bool readEntry(const std::string &path, Entry &entry);
+
+	static void writeEntry(const std::string &path, const Entry &entry);
+
+	/**
+	 * Download the textfile if it was modified since the entry was fetched
+	 * @return true iff a new version was written to `dataPath`
+	 */
+	static bool download(const std::string &dataPath, Entry &entry);
+
+	/**
+	 * Remove the least recently used files until the cache fits its size limit
+	 */
+	static void evict();
+};
+
+#endif /* UTIL_PANGAEACACHE_H_ */
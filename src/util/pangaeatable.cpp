@@ -0,0 +1,569 @@
+#include "pangaeatable.h"
+
+#include "util/concat.h"
+#include "util/configuration.h"
+#include "util/exceptions.h"
+#include "util/fastparse.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <fstream>
+#include <future>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+double PangaeaColumn::getNumeric(size_t row) const {
+	if(values != nullptr)
+		return values[row];
+
+	return FastParse::parseDouble(text + offsets[row], offsets[row + 1] - offsets[row]);
+}
+
+PangaeaTable::PangaeaTable(const std::vector<PangaeaAPI::Parameter> &parameters)
+		: rows(0), memoryLimit(Configuration::get<size_t>("pangaea.memory.max", 2048) * 1024 * 1024),
+		  parsedColumns(parameters.size()), isProjection(false),
+		  longitudeColumn(parameters.size()), latitudeColumn(parameters.size()) {
+	for(auto &parameter : parameters) {
+		if(longitudeColumn == parameters.size() && parameter.isLongitudeColumn())
+			longitudeColumn = columns.size();
+		if(latitudeColumn == parameters.size() && parameter.isLatitudeColumn())
+			latitudeColumn = columns.size();
+
+		ColumnData column;
+		column.name = parameter.name;
+		column.unit = parameter.unit;
+		column.numeric = parameter.numeric;
+		column.projected = true;
+		column.offsets.push_back(0);
+		columns.push_back(std::move(column));
+	}
+}
+
+PangaeaTable::PangaeaTable(const std::vector<PangaeaAPI::Parameter> &parameters, const std::set<std::string> &projection)
+		: PangaeaTable(parameters) {
+	isProjection = true;
+	parsedColumns = 0;
+	for(size_t i = 0; i < columns.size(); ++i) {
+		columns[i].projected = projection.count(columns[i].name) > 0;
+		if(columns[i].projected)
+			parsedColumns = i + 1;
+	}
+}
+
+void PangaeaTable::skipTextfileHeader(std::istream &textfile) {
+	std::string line;
+	std::getline(textfile, line);
+
+	auto endsComment = [](std::string &line) -> bool {
+		while(!line.empty() && line.back() == '\r')
+			line.pop_back();
+		return line.size() >= 2 && line.compare(line.size() - 2, 2, "*/") == 0;
+	};
+
+	if(line.compare(0, 2, "/*") == 0) {
+		// skip initial comment
+		while(!endsComment(line) && std::getline(textfile, line)) {
+		}
+		// skip header column
+		// TODO handle \n in column headers
+		std::getline(textfile, line);
+	}
+}
+
+void PangaeaTable::parse(std::istream &textfile) {
+	parse(textfile, Configuration::get<size_t>("pangaea.parser.threads", 4));
+}
+
+void PangaeaTable::parse(std::istream &textfile, size_t threads, size_t chunkSize) {
+	// chunks parsed in the background, appended in the order of the textfile
+	std::deque<std::future<PangaeaTable>> parts;
+
+	// read large chunks that end after their last complete line, carrying the incomplete line over
+	std::vector<char> buffer(chunkSize);
+	size_t filled = 0;
+	bool finished = false;
+
+	while(!finished) {
+		if(filled == buffer.size())
+			buffer.resize(buffer.size() * 2);
+
+		textfile.read(buffer.data() + filled, buffer.size() - filled);
+		filled += textfile.gcount();
+		finished = !textfile;
+
+		size_t chunkEnd = filled;
+		if(!finished) {
+			auto lastNewline = static_cast<const char *>(memrchr(buffer.data(), '\n', filled));
+			chunkEnd = lastNewline != nullptr ? lastNewline - buffer.data() + 1 : 0;
+		}
+		if(chunkEnd == 0)
+			continue;
+
+		if(threads <= 1) {
+			parseLines(buffer.data(), buffer.data() + chunkEnd);
+			filled -= chunkEnd;
+			std::memmove(buffer.data(), buffer.data() + chunkEnd, filled);
+			continue;
+		}
+
+		std::vector<char> next(std::max(chunkSize, filled - chunkEnd));
+		std::copy(buffer.begin() + chunkEnd, buffer.begin() + filled, next.begin());
+		filled -= chunkEnd;
+		buffer.resize(chunkEnd);
+
+		parts.push_back(std::async(std::launch::async, [](PangaeaTable part, std::vector<char> chunk) {
+			part.parseLines(chunk.data(), chunk.data() + chunk.size());
+			return part;
+		}, createPart(), std::move(buffer)));
+		buffer = std::move(next);
+
+		while(parts.size() >= threads) {
+			append(parts.front().get());
+			parts.pop_front();
+		}
+	}
+
+	while(!parts.empty()) {
+		append(parts.front().get());
+		parts.pop_front();
+	}
+}
+
+void PangaeaTable::parseLines(const char *begin, const char *end) {
+	const char *line = begin;
+	while(line < end) {
+		const char *lineEnd = FastParse::find(line, end, '\n');
+
+		const char *rowEnd = lineEnd;
+		while(rowEnd > line && rowEnd[-1] == '\r')
+			--rowEnd;
+		if(rowEnd > line)
+			parseRow(line, rowEnd);
+
+		line = lineEnd < end ? lineEnd + 1 : end;
+	}
+
+	checkMemoryLimit();
+}
+
+PangaeaTable PangaeaTable::createPart() const {
+	PangaeaTable part;
+	part.rows = 0;
+	part.memoryLimit = memoryLimit;
+	part.parsedColumns = parsedColumns;
+	part.isProjection = isProjection;
+	part.longitudeColumn = longitudeColumn;
+	part.latitudeColumn = latitudeColumn;
+
+	for(auto &column : columns) {
+		ColumnData partColumn;
+		partColumn.name = column.name;
+		partColumn.unit = column.unit;
+		partColumn.numeric = column.numeric;
+		partColumn.projected = column.projected;
+		partColumn.offsets.push_back(0);
+		part.columns.push_back(std::move(partColumn));
+	}
+
+	return part;
+}
+
+void PangaeaTable::append(PangaeaTable &&part) {
+	for(size_t i = 0; i < columns.size(); ++i) {
+		ColumnData &column = columns[i];
+		ColumnData &partColumn = part.columns[i];
+		if(!column.projected)
+			continue;
+
+		column.values.insert(column.values.end(), partColumn.values.begin(), partColumn.values.end());
+
+		const uint64_t base = column.text.size();
+		column.offsets.reserve(column.offsets.size() + partColumn.offsets.size() - 1);
+		for(size_t j = 1; j < partColumn.offsets.size(); ++j)
+			column.offsets.push_back(base + partColumn.offsets[j]);
+		column.text.append(partColumn.text);
+	}
+
+	rows += part.rows;
+
+	checkMemoryLimit();
+}
+
+void PangaeaTable::setMemoryLimit(size_t bytes) {
+	memoryLimit = bytes;
+}
+
+size_t PangaeaTable::getMemoryUsage() const {
+	size_t bytes = 0;
+	for(auto &column : columns)
+		bytes += column.text.capacity() + column.offsets.capacity() * sizeof(uint64_t) + column.values.capacity() * sizeof(double);
+	return bytes;
+}
+
+void PangaeaTable::checkMemoryLimit() const {
+	if(memoryLimit > 0 && getMemoryUsage() > memoryLimit)
+		throw OperatorException(concat("PangaeaTable: the data set needs more than ", memoryLimit / (1024 * 1024),
+									   " MiB of memory (pangaea.memory.max), request fewer columns or a smaller area"));
+}
+
+void PangaeaTable::parseRow(const char *begin, const char *end) {
+	const char *field = begin;
+	for(size_t i = 0; i < parsedColumns; ++i) {
+		ColumnData &column = columns[i];
+		const char *fieldEnd = field;
+		if(field < end)
+			fieldEnd = FastParse::find(field, end, '\t');
+
+		if(!column.projected) {
+			field = fieldEnd < end ? fieldEnd + 1 : end;
+			continue;
+		}
+
+		size_t length = fieldEnd - field;
+		column.text.append(field, length);
+		column.offsets.push_back(column.text.size());
+		if(column.numeric)
+			column.values.push_back(FastParse::parseDouble(field, length));
+
+		// missing trailing fields are empty
+		field = fieldEnd < end ? fieldEnd + 1 : end;
+	}
+
+	++rows;
+}
+
+size_t PangaeaTable::getRowCount() const {
+	return rows;
+}
+
+std::vector<PangaeaColumn> PangaeaTable::getColumns() const {
+	std::vector<PangaeaColumn> views;
+	for(auto &column : columns) {
+		if(!column.projected)
+			continue;
+		views.push_back(PangaeaColumn{column.name, column.numeric,
+									  column.numeric ? column.values.data() : nullptr,
+									  column.offsets.data(), column.text.data()});
+	}
+	return views;
+}
+
+/**
+ * size rounded up to 8 bytes, so that all sections of the columnar file are aligned
+ */
+static uint64_t aligned(uint64_t size) {
+	return (size + 7) & ~static_cast<uint64_t>(7);
+}
+
+size_t PangaeaColumnarFile::gridCell(double value, double min, double max, uint64_t gridSize) {
+	if(!(max > min))
+		return 0;
+
+	double cell = std::floor((value - min) / (max - min) * gridSize);
+	if(!(cell > 0))
+		return 0;
+	return std::min(static_cast<size_t>(cell), static_cast<size_t>(gridSize - 1));
+}
+
+void PangaeaTable::write(const std::string &path, uint64_t sourceSize, int64_t sourceModified) const {
+	if(isProjection)
+		throw MustNotHappenException("PangaeaTable: a projected table cannot be written as columnar file");
+
+	Json::Value schemaJson(Json::arrayValue);
+	for(auto &column : columns) {
+		Json::Value parameter(Json::objectValue);
+		parameter["name"] = column.name;
+		parameter["unit"] = column.unit;
+		parameter["numeric"] = column.numeric;
+		schemaJson.append(parameter);
+	}
+	Json::FastWriter writer;
+	const std::string schema = writer.write(schemaJson);
+
+	PangaeaColumnarFile::Header header{};
+	std::strncpy(header.magic, PangaeaColumnarFile::MAGIC, sizeof(header.magic));
+	header.rows = rows;
+	header.columns = columns.size();
+	header.schemaOffset = aligned(sizeof(header) + columns.size() * sizeof(PangaeaColumnarFile::ColumnHeader));
+	header.schemaSize = schema.size();
+	header.sourceSize = sourceSize;
+	header.sourceModified = sourceModified;
+
+	std::vector<PangaeaColumnarFile::ColumnHeader> columnHeaders;
+	uint64_t offset = aligned(header.schemaOffset + header.schemaSize);
+	for(auto &column : columns) {
+		PangaeaColumnarFile::ColumnHeader columnHeader{};
+		columnHeader.numeric = column.numeric ? 1 : 0;
+		if(column.numeric) {
+			columnHeader.valuesOffset = offset;
+			offset += rows * sizeof(double);
+		}
+		columnHeader.offsetsOffset = offset;
+		offset += (rows + 1) * sizeof(uint64_t);
+		columnHeader.textOffset = offset;
+		columnHeader.textSize = column.text.size();
+		offset = aligned(offset + column.text.size());
+		columnHeaders.push_back(columnHeader);
+	}
+
+	// spatial index: counting sort of the georeferenced rows by grid cell, keeping the row order within a cell
+	std::vector<uint64_t> cellStart;
+	std::vector<uint64_t> rowIds;
+	header.indexXColumn = columns.size();
+	header.indexYColumn = columns.size();
+	if(longitudeColumn < columns.size() && latitudeColumn < columns.size()) {
+		auto views = getColumns();
+		const PangaeaColumn &x = views[longitudeColumn];
+		const PangaeaColumn &y = views[latitudeColumn];
+
+		double x1 = INFINITY, y1 = INFINITY, x2 = -INFINITY, y2 = -INFINITY;
+		size_t georeferenced = 0;
+		for(size_t row = 0; row < rows; ++row) {
+			double px = x.getNumeric(row), py = y.getNumeric(row);
+			if(!std::isfinite(px) || !std::isfinite(py))
+				continue;
+			x1 = std::min(x1, px);
+			x2 = std::max(x2, px);
+			y1 = std::min(y1, py);
+			y2 = std::max(y2, py);
+			++georeferenced;
+		}
+
+		// aim for about 16 points per cell
+		uint64_t gridSize = static_cast<uint64_t>(std::ceil(std::sqrt(georeferenced / 16.0)));
+		gridSize = std::max<uint64_t>(1, std::min<uint64_t>(gridSize, 1024));
+
+		cellStart.assign(gridSize * gridSize + 1, 0);
+		std::vector<uint64_t> cells(rows, cellStart.size());
+		for(size_t row = 0; row < rows; ++row) {
+			double px = x.getNumeric(row), py = y.getNumeric(row);
+			if(!std::isfinite(px) || !std::isfinite(py))
+				continue;
+			cells[row] = PangaeaColumnarFile::gridCell(py, y1, y2, gridSize) * gridSize
+						 + PangaeaColumnarFile::gridCell(px, x1, x2, gridSize);
+			++cellStart[cells[row] + 1];
+		}
+		for(size_t cell = 1; cell < cellStart.size(); ++cell)
+			cellStart[cell] += cellStart[cell - 1];
+
+		rowIds.resize(georeferenced);
+		std::vector<uint64_t> next(cellStart.begin(), cellStart.end() - 1);
+		for(size_t row = 0; row < rows; ++row) {
+			if(cells[row] < next.size())
+				rowIds[next[cells[row]]++] = row;
+		}
+
+		header.indexXColumn = longitudeColumn;
+		header.indexYColumn = latitudeColumn;
+		header.gridSize = gridSize;
+		header.gridX1 = georeferenced > 0 ? x1 : 0;
+		header.gridY1 = georeferenced > 0 ? y1 : 0;
+		header.gridX2 = georeferenced > 0 ? x2 : 0;
+		header.gridY2 = georeferenced > 0 ? y2 : 0;
+		header.cellStartOffset = offset;
+		offset += cellStart.size() * sizeof(uint64_t);
+		header.rowIdsOffset = offset;
+		header.rowIdsCount = rowIds.size();
+		offset += rowIds.size() * sizeof(uint64_t);
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if(!file)
+		throw OperatorException(concat("PangaeaTable: could not create columnar file ", path));
+
+	const char padding[8] = {};
+	auto pad = [&file, &padding]() {
+		file.write(padding, aligned(file.tellp()) - file.tellp());
+	};
+
+	file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char *>(columnHeaders.data()), columnHeaders.size() * sizeof(PangaeaColumnarFile::ColumnHeader));
+	pad();
+	file.write(schema.data(), schema.size());
+	pad();
+	for(auto &column : columns) {
+		if(column.numeric)
+			file.write(reinterpret_cast<const char *>(column.values.data()), column.values.size() * sizeof(double));
+		file.write(reinterpret_cast<const char *>(column.offsets.data()), column.offsets.size() * sizeof(uint64_t));
+		file.write(column.text.data(), column.text.size());
+		pad();
+	}
+	file.write(reinterpret_cast<const char *>(cellStart.data()), cellStart.size() * sizeof(uint64_t));
+	file.write(reinterpret_cast<const char *>(rowIds.data()), rowIds.size() * sizeof(uint64_t));
+
+	if(!file)
+		throw OperatorException(concat("PangaeaTable: could not write columnar file ", path));
+}
+
+Json::Value PangaeaColumnarFile::schemaToJson(const std::vector<PangaeaAPI::Parameter> &parameters) {
+	Json::Value json(Json::arrayValue);
+	for(auto &parameter : parameters)
+		json.append(parameter.toJson());
+	return json;
+}
+
+PangaeaColumnarFile::PangaeaColumnarFile(const std::string &path)
+		: data(nullptr), size(0), header{}, cellStart(nullptr), rowIds(nullptr) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		throw OperatorException(concat("PangaeaColumnarFile: could not open ", path));
+
+	struct stat status{};
+	if(fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(Header)) {
+		close(fd);
+		throw OperatorException(concat("PangaeaColumnarFile: invalid file ", path));
+	}
+
+	size = status.st_size;
+	void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED)
+		throw OperatorException(concat("PangaeaColumnarFile: could not map ", path));
+	data = reinterpret_cast<const char *>(mapping);
+
+	std::memcpy(&header, data, sizeof(Header));
+
+	auto inBounds = [this](uint64_t offset, uint64_t length) -> bool {
+		return offset <= size && length <= size - offset;
+	};
+
+	if(std::strncmp(header.magic, MAGIC, sizeof(header.magic)) != 0
+	   || header.columns > size / sizeof(ColumnHeader)
+	   || !inBounds(sizeof(Header), header.columns * sizeof(ColumnHeader))
+	   || !inBounds(header.schemaOffset, header.schemaSize)) {
+		munmap(const_cast<char *>(data), size);
+		throw OperatorException(concat("PangaeaColumnarFile: invalid file ", path));
+	}
+
+	Json::Reader reader;
+	if(!reader.parse(data + header.schemaOffset, data + header.schemaOffset + header.schemaSize, schema)
+	   || !schema.isArray() || schema.size() != header.columns) {
+		munmap(const_cast<char *>(data), size);
+		throw OperatorException(concat("PangaeaColumnarFile: invalid schema in ", path));
+	}
+
+	auto columnHeaders = reinterpret_cast<const ColumnHeader *>(data + sizeof(Header));
+	for(size_t i = 0; i < header.columns; ++i) {
+		const ColumnHeader &columnHeader = columnHeaders[i];
+		if((columnHeader.numeric && (columnHeader.valuesOffset % 8 != 0 || !inBounds(columnHeader.valuesOffset, header.rows * sizeof(double))))
+		   || columnHeader.offsetsOffset % 8 != 0
+		   || header.rows >= size / sizeof(uint64_t)
+		   || !inBounds(columnHeader.offsetsOffset, (header.rows + 1) * sizeof(uint64_t))
+		   || !inBounds(columnHeader.textOffset, columnHeader.textSize)) {
+			munmap(const_cast<char *>(data), size);
+			throw OperatorException(concat("PangaeaColumnarFile: invalid column in ", path));
+		}
+
+		// every field must lie within the text of its column
+		const uint64_t *offsets = reinterpret_cast<const uint64_t *>(data + columnHeader.offsetsOffset);
+		bool validOffsets = offsets[0] == 0 && offsets[header.rows] <= columnHeader.textSize;
+		for(size_t row = 0; validOffsets && row < header.rows; ++row)
+			validOffsets = offsets[row] <= offsets[row + 1];
+		if(!validOffsets) {
+			munmap(const_cast<char *>(data), size);
+			throw OperatorException(concat("PangaeaColumnarFile: invalid text offsets in ", path));
+		}
+
+		columns.push_back(PangaeaColumn{
+				schema[static_cast<Json::ArrayIndex>(i)].get("name", "").asString(),
+				columnHeader.numeric != 0,
+				columnHeader.numeric ? reinterpret_cast<const double *>(data + columnHeader.valuesOffset) : nullptr,
+				reinterpret_cast<const uint64_t *>(data + columnHeader.offsetsOffset),
+				data + columnHeader.textOffset
+		});
+	}
+
+	if(header.indexXColumn < header.columns && header.indexYColumn < header.columns) {
+		if(header.gridSize == 0 || header.gridSize > 1024
+		   || header.cellStartOffset % 8 != 0 || header.rowIdsOffset % 8 != 0
+		   || header.rowIdsCount > size / sizeof(uint64_t)
+		   || !inBounds(header.cellStartOffset, (header.gridSize * header.gridSize + 1) * sizeof(uint64_t))
+		   || !inBounds(header.rowIdsOffset, header.rowIdsCount * sizeof(uint64_t))) {
+			munmap(const_cast<char *>(data), size);
+			throw OperatorException(concat("PangaeaColumnarFile: invalid spatial index in ", path));
+		}
+
+		cellStart = reinterpret_cast<const uint64_t *>(data + header.cellStartOffset);
+		rowIds = reinterpret_cast<const uint64_t *>(data + header.rowIdsOffset);
+		bool validIndex = cellStart[0] == 0 && cellStart[header.gridSize * header.gridSize] == header.rowIdsCount;
+		for(size_t cell = 0; validIndex && cell < header.gridSize * header.gridSize; ++cell)
+			validIndex = cellStart[cell] <= cellStart[cell + 1];
+		if(!validIndex) {
+			munmap(const_cast<char *>(data), size);
+			throw OperatorException(concat("PangaeaColumnarFile: invalid spatial index in ", path));
+		}
+	}
+}
+
+PangaeaColumnarFile::~PangaeaColumnarFile() {
+	munmap(const_cast<char *>(data), size);
+}
+
+bool PangaeaColumnarFile::isUpToDate(const std::string &path, uint64_t sourceSize, int64_t sourceModified,
+									 const std::vector<PangaeaAPI::Parameter> &parameters) {
+	if(access(path.c_str(), R_OK) != 0)
+		return false;
+
+	try {
+		PangaeaColumnarFile file(path);
+		return file.header.sourceSize == sourceSize
+			   && file.header.sourceModified == sourceModified
+			   && file.schema == schemaToJson(parameters);
+	} catch (const OperatorException &) {
+		return false;
+	}
+}
+
+size_t PangaeaColumnarFile::getRowCount() const {
+	return header.rows;
+}
+
+const std::vector<PangaeaColumn> &PangaeaColumnarFile::getColumns() const {
+	return columns;
+}
+
+bool PangaeaColumnarFile::hasSpatialIndex(const std::string &xColumn, const std::string &yColumn) const {
+	return cellStart != nullptr
+		   && columns[header.indexXColumn].name == xColumn
+		   && columns[header.indexYColumn].name == yColumn;
+}
+
+std::vector<size_t> PangaeaColumnarFile::queryRows(double x1, double y1, double x2, double y2) const {
+	std::vector<size_t> rows;
+	if(cellStart == nullptr)
+		throw OperatorException("PangaeaColumnarFile: no spatial index");
+
+	if(header.rowIdsCount == 0 || x2 < header.gridX1 || x1 > header.gridX2 || y2 < header.gridY1 || y1 > header.gridY2)
+		return rows;
+
+	const PangaeaColumn &x = columns[header.indexXColumn];
+	const PangaeaColumn &y = columns[header.indexYColumn];
+
+	const size_t cellX1 = gridCell(x1, header.gridX1, header.gridX2, header.gridSize);
+	const size_t cellX2 = gridCell(x2, header.gridX1, header.gridX2, header.gridSize);
+	const size_t cellY1 = gridCell(y1, header.gridY1, header.gridY2, header.gridSize);
+	const size_t cellY2 = gridCell(y2, header.gridY1, header.gridY2, header.gridSize);
+
+	// the cells of a grid row are contiguous, so every grid row is a single range of row ids
+	for(size_t cellY = cellY1; cellY <= cellY2; ++cellY) {
+		const uint64_t begin = cellStart[cellY * header.gridSize + cellX1];
+		const uint64_t end = cellStart[cellY * header.gridSize + cellX2 + 1];
+		for(uint64_t i = begin; i < end; ++i) {
+			const size_t row = rowIds[i];
+			if(row >= header.rows)
+				continue;
+			double px = x.getNumeric(row), py = y.getNumeric(row);
+			if(px >= x1 && px <= x2 && py >= y1 && py <= y2)
+				rows.push_back(row);
+		}
+	}
+
+	// restore the order of the data set
+	std::sort(rows.begin(), rows.end());
+	return rows;
+}
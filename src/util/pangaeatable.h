@@ -0,0 +1,231 @@
+#ifndef UTIL_PANGAEATABLE_H_
+#define UTIL_PANGAEATABLE_H_
+
+#include "util/pangaeaapi.h"
+
+#include <cstdint>
+#include <istream>
+#include <set>
+#include <string>
+#include <vector>
+#include <json/json.h>
+
+/**
+ * Read-only view of a column of a Pangaea data set.
+ *
+ * The text of every field is available, numeric columns additionally provide their parsed values.
+ */
+class PangaeaColumn {
+public:
+	std::string name;
+	bool numeric;
+
+	/// parsed values, `nullptr` if the column is not numeric
+	const double *values;
+	/// row i spans text[offsets[i], offsets[i + 1])
+	const uint64_t *offsets;
+	const char *text;
+
+	std::string getText(size_t row) const {
+		return std::string(text + offsets[row], offsets[row + 1] - offsets[row]);
+	}
+
+	/**
+	 * @return the numeric value of a field, NaN if it is empty or not a number
+	 */
+	double getNumeric(size_t row) const;
+};
+
+/**
+ * In-memory columnar representation of the rows of a Pangaea textfile
+ */
+class PangaeaTable {
+public:
+	explicit PangaeaTable(const std::vector<PangaeaAPI::Parameter> &parameters);
+
+	/**
+	 * Create a table that only keeps some of the columns. The other fields are skipped while parsing
+	 * and rows are not split beyond the last projected column.
+	 * @param projection names of the columns to keep
+	 */
+	PangaeaTable(const std::vector<PangaeaAPI::Parameter> &parameters, const std::set<std::string> &projection);
+
+	/**
+	 * skip the initial comment block and the header line of a Pangaea textfile
+	 */
+	static void skipTextfileHeader(std::istream &textfile);
+
+	/**
+	 * parse the rows of a textfile, positioned after its header line, with `pangaea.parser.threads` threads
+	 */
+	void parse(std::istream &textfile);
+
+	/**
+	 * parse the rows of a textfile in newline aligned chunks. With more than one thread, chunks are parsed
+	 * concurrently and appended in order, so the result is identical to parsing with a single thread.
+	 */
+	void parse(std::istream &textfile, size_t threads, size_t chunkSize = 4 << 20);
+
+	size_t getRowCount() const;
+
+	/**
+	 * Limit the memory of the parsed columns, parsing throws an OperatorException when it is exceeded.
+	 * Defaults to `pangaea.memory.max` MiB.
+	 * @param bytes the limit, 0 for no limit
+	 */
+	void setMemoryLimit(size_t bytes);
+
+	/**
+	 * @return the number of bytes allocated for the parsed columns
+	 */
+	size_t getMemoryUsage() const;
+
+	/**
+	 * @return views of all projected columns, invalidated by further parsing
+	 */
+	std::vector<PangaeaColumn> getColumns() const;
+
+	/**
+	 * write the table as columnar file, see `PangaeaColumnarFile`. Projected tables cannot be written.
+	 * @param sourceSize size of the textfile the table was parsed from
+	 * @param sourceModified modification time of the textfile the table was parsed from
+	 */
+	void write(const std::string &path, uint64_t sourceSize, int64_t sourceModified) const;
+
+private:
+	class ColumnData {
+	public:
+		std::string name;
+		std::string unit;
+		bool numeric;
+		bool projected;
+
+		std::vector<double> values;
+		std::vector<uint64_t> offsets;
+		std::string text;
+	};
+
+	PangaeaTable() = default;
+
+	/**
+	 * @return an empty table with the same columns, for parsing a chunk of the textfile
+	 */
+	PangaeaTable createPart() const;
+
+	/**
+	 * append the rows of a table created by `createPart`
+	 */
+	void append(PangaeaTable &&part);
+
+	void parseLines(const char *begin, const char *end);
+
+	void parseRow(const char *begin, const char *end);
+
+	/**
+	 * throw if the parsed columns exceed the memory limit
+	 */
+	void checkMemoryLimit() const;
+
+	std::vector<ColumnData> columns;
+	size_t rows;
+	size_t memoryLimit;
+
+	/// number of columns up to the last projected one
+	size_t parsedColumns;
+	bool isProjection;
+
+	/// longitude and latitude column used for the spatial index, `columns.size()` if there is none
+	size_t longitudeColumn;
+	size_t latitudeColumn;
+};
+
+/**
+ * Memory mapped binary file holding the columns of a Pangaea data set.
+ *
+ * Layout: a header, one directory entry per column, the parameter schema as JSON, the
+ * 8-byte aligned column data (values, offsets, text) and a spatial index.
+ *
+ * The spatial index is a packed grid over the longitude/latitude columns: the row ids sorted by
+ * grid cell (row-major) and the start of every cell in that array.
+ */
+class PangaeaColumnarFile {
+public:
+	explicit PangaeaColumnarFile(const std::string &path);
+
+	~PangaeaColumnarFile();
+
+	PangaeaColumnarFile(const PangaeaColumnarFile &) = delete;
+	PangaeaColumnarFile &operator=(const PangaeaColumnarFile &) = delete;
+
+	/**
+	 * @return true iff the file exists and was written from the given textfile with the given parameters
+	 */
+	static bool isUpToDate(const std::string &path, uint64_t sourceSize, int64_t sourceModified,
+						   const std::vector<PangaeaAPI::Parameter> &parameters);
+
+	size_t getRowCount() const;
+
+	const std::vector<PangaeaColumn> &getColumns() const;
+
+	/**
+	 * @return true iff the file has a spatial index with the given x and y column
+	 */
+	bool hasSpatialIndex(const std::string &xColumn, const std::string &yColumn) const;
+
+	/**
+	 * Use the spatial index to find all rows with coordinates inside a rectangle
+	 * @return the row ids in ascending order
+	 */
+	std::vector<size_t> queryRows(double x1, double y1, double x2, double y2) const;
+
+private:
+	friend class PangaeaTable;
+
+	struct Header {
+		char magic[8];
+		uint64_t rows;
+		uint64_t columns;
+		uint64_t schemaOffset;
+		uint64_t schemaSize;
+		uint64_t sourceSize;
+		int64_t sourceModified;
+
+		// spatial index, `indexXColumn` equals `columns` if there is none
+		uint64_t indexXColumn;
+		uint64_t indexYColumn;
+		uint64_t gridSize;
+		double gridX1, gridY1, gridX2, gridY2;
+		uint64_t cellStartOffset;
+		uint64_t rowIdsOffset;
+		uint64_t rowIdsCount;
+	};
+
+	struct ColumnHeader {
+		uint64_t numeric;
+		uint64_t valuesOffset;
+		uint64_t offsetsOffset;
+		uint64_t textOffset;
+		uint64_t textSize;
+	};
+
+	static constexpr const char *MAGIC = "PGCOL02";
+
+	static Json::Value schemaToJson(const std::vector<PangaeaAPI::Parameter> &parameters);
+
+	/**
+	 * @return the grid cell of a coordinate along one axis, clamped to the grid
+	 */
+	static size_t gridCell(double value, double min, double max, uint64_t gridSize);
+
+	const char *data;
+	size_t size;
+
+	Header header;
+	Json::Value schema;
+	std::vector<PangaeaColumn> columns;
+
+	const uint64_t *cellStart;
+	const uint64_t *rowIds;
+};
+
+#endif /* UTIL_PANGAEATABLE_H_ */
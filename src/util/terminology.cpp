@@ -1,15 +1,107 @@
 
 #include "terminology.h"
+#include <algorithm>
 #include <vector>
 #include <iostream>
 #include <future>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <Poco/Exception.h>
+#include <thread>
 #include "util/configuration.h"
+#include "util/concat.h"
+#include "util/log.h"
+#include "util/aimdlimiter.h"
+#include "util/fairexecutor.h"
+#include "util/terminologysnapshot.h"
 
-#include <boost/shared_ptr.hpp>
-#include <boost/make_shared.hpp>
-#include <boost/thread.hpp>
-#include <boost/asio.hpp>
-#include <boost/move/move.hpp>
+/**
+ * The executor of all terminology requests, `terminology.threads` caps the concurrent requests of the process
+ */
+static FairExecutor &executor() {
+    static FairExecutor executor(Configuration::get<int>("terminology.threads", 16));
+    return executor;
+}
+
+/**
+ * Lowers the concurrent requests below `terminology.threads` while the service is slow or failing
+ */
+static AIMDLimiter &limiter() {
+    static AIMDLimiter limiter(Configuration::get<int>("terminology.threads", 16),
+                               std::chrono::milliseconds(Configuration::get<long>("terminology.latency_target", 2000)));
+    return limiter;
+}
+
+static Poco::Net::Context::Ptr tlsContext() {
+    static Poco::Net::Context::Ptr context = [] {
+        Poco::Net::Context::Ptr context = new Poco::Net::Context(
+                Poco::Net::Context::CLIENT_USE,
+                "",
+                Poco::Net::Context::VERIFY_RELAXED,
+                9,
+                true
+        );
+        context->enableSessionCache(true);
+        return context;
+    }();
+    return context;
+}
+
+static std::mutex tls_session_mutex;
+static Poco::Net::Session::Ptr tls_session;
+
+/**
+ * @return the TLS session of the last request, so that new connections can resume it instead of a full handshake
+ */
+static Poco::Net::Session::Ptr lastTlsSession() {
+    std::lock_guard<std::mutex> lock(tls_session_mutex);
+    return tls_session;
+}
+
+static void setLastTlsSession(Poco::Net::Session::Ptr session) {
+    std::lock_guard<std::mutex> lock(tls_session_mutex);
+    tls_session = session;
+}
+
+using session_ptr = std::unique_ptr<Poco::Net::HTTPSClientSession>;
+
+static std::mutex idle_sessions_mutex;
+static std::vector<session_ptr> idle_sessions;
+
+/**
+ * Take an idle keep-alive connection to the host of the uri or open a new one
+ * @param reused set to true iff the connection was used before
+ */
+static session_ptr acquireSession(const Poco::URI &uri, bool &reused) {
+    {
+        std::lock_guard<std::mutex> lock(idle_sessions_mutex);
+        for(auto it = idle_sessions.rbegin(); it != idle_sessions.rend(); ++it) {
+            if((*it)->getHost() == uri.getHost() && (*it)->getPort() == uri.getPort()) {
+                session_ptr session = std::move(*it);
+                idle_sessions.erase(std::next(it).base());
+                reused = true;
+                return session;
+            }
+        }
+    }
+
+    reused = false;
+    auto session = std::make_unique<Poco::Net::HTTPSClientSession>(uri.getHost(), uri.getPort(), tlsContext(), lastTlsSession());
+    session->setKeepAlive(true);
+    session->setTimeout(Poco::Timespan(Configuration::get<long>("terminology.timeout", 10), 0));
+    return session;
+}
+
+/**
+ * Keep a connection for later requests, at most one per executor thread
+ */
+static void releaseSession(session_ptr session) {
+    std::lock_guard<std::mutex> lock(idle_sessions_mutex);
+    if(idle_sessions.size() < static_cast<size_t>(Configuration::get<int>("terminology.threads", 16)))
+        idle_sessions.push_back(std::move(session));
+}
 
 std::vector<std::string> Terminology::resolveMultiple(const std::vector<std::string> &names_in,
                                                       const std::string &terminology,
@@ -17,202 +109,190 @@ std::vector<std::string> Terminology::resolveMultiple(const std::vector<std::str
                                                       const std::string &match_type,
                                                       const bool first_hit,
                                                       const HandleNotResolvable on_not_resolvable){
-
-    std::vector<std::string> names_out;
     if(names_in.empty())
-        return names_out;
-    names_out.reserve(names_in.size());
-
-    //get a set with all names to be resolved (so we don't request the same name multiple times)
-    std::set<std::string> to_resolve;
-    std::map<std::string, std::string> resolved_pairs;
+        return std::vector<std::string>();
 
-    for(auto &name : names_in){
-        to_resolve.insert(name);
-    }
-
-    //aliases only needed in this method.
-    using task_t  = boost::packaged_task<string_pair>;
-    using ptask_t = boost::shared_ptr<task_t>;
+    Pipeline pipeline(terminology, key, match_type, first_hit, on_not_resolvable);
+    return pipeline.resolve(names_in);
+}
 
-    //init thread pool
-    int threads_num = Configuration::get<int>("terminology.threads",16);
-    if(threads_num > to_resolve.size())
-        threads_num = to_resolve.size();
+Terminology::Pipeline::Pipeline(const std::string &terminology,
+                                const std::string &key,
+                                const std::string &match_type,
+                                const bool first_hit,
+                                const HandleNotResolvable on_not_resolvable)
+        : query{terminology, key, match_type, first_hit}, on_not_resolvable(on_not_resolvable),
+          requests(new FairExecutor::Group(executor())) {}
 
-    boost::asio::io_service io_service;
-    boost::thread_group threads;
-    boost::asio::io_service::work work(io_service);
+Terminology::Pipeline::~Pipeline() = default;
 
-    for(int i = 0; i < threads_num; i++){
-        threads.create_thread(boost::bind(&boost::asio::io_service::run, &io_service));
+void Terminology::Pipeline::add(const std::vector<std::string> &names){
+    //get a set with all new names (so we don't request the same name multiple times)
+    std::set<std::string> to_resolve;
+    for(auto &name : names){
+        if(added.insert(name).second)
+            to_resolve.insert(name);
     }
 
-    std::vector<boost::shared_future<string_pair>> pending_results;
-
-    // create context, enable session cache. First name has to be resolved separately
-    // and not in a thread to retrieve the session ptr.
-    Poco::Net::Context::Ptr context = new Poco::Net::Context(
-            Poco::Net::Context::CLIENT_USE,
-            "",
-            Poco::Net::Context::VERIFY_RELAXED,
-            9,
-            true
-    );
-    context->enableSessionCache(true);
-
-    // declare iterator here to take first element, resolve it no in thread
-    auto begin = to_resolve.begin();
-
-    //pair<string_pair, Session::Ptr>
-    auto first_resolved = resolveSingleNameSetSessionPtr(context, *begin, terminology, key, match_type, first_hit, on_not_resolvable);
-    Poco::Net::Session::Ptr session_ptr = first_resolved.second;
-    resolved_pairs.insert(first_resolved.first);
-
-    // move iterator to next element
-    begin++;
-
-    // use iterator to push tasks for all names left into the thread pool
-    for(auto it = begin; it != to_resolve.end(); it++) {
-        const std::string &name = *it;
-        ptask_t task = boost::make_shared<task_t>(
-                boost::bind(resolveSingleNameInternal, context, session_ptr, name, terminology, key, match_type, first_hit, on_not_resolvable));
-        boost::shared_future<string_pair> future(task->get_future());
-        pending_results.push_back(future);
-        io_service.post(boost::bind(&task_t::operator(), task));
+    //only request names that neither the local snapshot nor the cache know
+    TerminologySnapshot::resolve(query, to_resolve, resolved);
+    TerminologyCache::get(query, to_resolve, resolved, cache_connection);
+
+    // the requests of all queries share one executor, so concurrent queries neither multiply the
+    // threads nor starve each other
+    for(auto &name : to_resolve) {
+        requests->submit([this, name] {
+            resolution_pair result = resolveSingleNameInternal(name, query);
+            std::lock_guard<std::mutex> lock(requested_mutex);
+            requested.insert(std::move(result));
+        });
     }
+}
+
+std::vector<std::string> Terminology::Pipeline::resolve(const std::vector<std::string> &names){
+    add(names);
+    requests->wait();
 
-    //get the resolved pairs from the futures, insert into map
-    for(auto &future : pending_results){
-        resolved_pairs.insert(future.get());
+    if(!requested.empty()) {
+        TerminologyCache::put(query, requested, cache_connection);
+        resolved.insert(requested.begin(), requested.end());
+        requested.clear();
     }
 
     //insert values from resolved pairs into names_out
-    for(auto &name : names_in){
-        names_out.push_back(resolved_pairs[name]);
+    std::vector<std::string> names_out;
+    names_out.reserve(names.size());
+    for(auto &name : names){
+        names_out.push_back(toResult(name, resolved.at(name), on_not_resolvable));
     }
 
     return names_out;
 }
 
-/**
- *
- * @return a pair of strings, first string is the string to be resolved and the second is the resolved string.
- */
-Terminology::string_pair Terminology::resolveSingleNameInternal(Poco::Net::Context::Ptr &context,
-                                                   Poco::Net::Session::Ptr &session_ptr,
-                                                   const std::string &name,
-                                                   const std::string &terminology,
-                                                   const std::string &key,
-                                                   const std::string &match_type,
-                                                   const bool first_hit,
-                                                   const HandleNotResolvable &on_not_resolvable)
-{
+Poco::URI Terminology::searchUri(const std::string &name, const TerminologyCache::Query &query) {
     std::string uri_string = Configuration::get<std::string>("terminology.url_search");
     Poco::URI uri(uri_string);
     uri.addQueryParameter("query", name);
-    uri.addQueryParameter("terminologies", terminology);
-    uri.addQueryParameter("match_type", match_type);
-    if(first_hit)
+    uri.addQueryParameter("terminologies", query.terminology);
+    uri.addQueryParameter("match_type", query.matchType);
+    if(query.firstHit)
         uri.addQueryParameter("first_hit", "true");
+    return uri;
+}
 
-    Poco::Net::HTTPSClientSession session(uri.getHost(), uri.getPort(), context, session_ptr);
-    Poco::Net::HTTPRequest request(Poco::Net::HTTPRequest::HTTP_GET, uri.getPathAndQuery(), Poco::Net::HTTPRequest::HTTP_1_1);
-    Poco::Net::HTTPResponse response;
+TerminologyCache::Resolution Terminology::readResolution(Poco::Net::HTTPResponse &response,
+                                                         std::istream &response_stream,
+                                                         const std::string &key) {
+    using State = TerminologyCache::Resolution::State;
 
-    session.sendRequest(request);
-    std::istream& respStream = session.receiveResponse(response);
+    const auto status = response.getStatus();
 
-    //read response stream into json object
-    Json::Value response_json;
-    if (response.getStatus() == Poco::Net::HTTPResponse::HTTP_OK)
-    {
-        respStream >> response_json;
-    } else {
-        response_json = Json::Value::null;
-    }
+    // the service rejects the request itself, repeating it gives the same answer. Timeouts and rate limits are not final.
+    if (status >= Poco::Net::HTTPResponse::HTTP_BAD_REQUEST && status < Poco::Net::HTTPResponse::HTTP_INTERNAL_SERVER_ERROR
+        && status != Poco::Net::HTTPResponse::HTTP_REQUEST_TIMEOUT && status != Poco::Net::HTTPResponse::HTTP_TOO_MANY_REQUESTS)
+        return {State::NOT_RESOLVABLE, ""};
+
+    if (status != Poco::Net::HTTPResponse::HTTP_OK)
+        return {State::FAILED, ""};
+
+    try {
+        //read response stream into json object
+        Json::Value response_json;
+        response_stream >> response_json;
+
+        //retrieve wanted element from result json, if not valid result it is not resolvable.
+        if (response_json.isNull())
+            return {State::NOT_RESOLVABLE, ""};
 
-    //retrieve wanted element from result json, if not valid result return not_resolved.
-    std::string not_resolved = (on_not_resolvable == HandleNotResolvable::EMPTY) ? "" : name;
-    if (response_json.isNull())
-    {
-        return std::make_pair(name, not_resolved);
-    } else
-    {
         Json::Value results = response_json["results"];
-        if(results.empty())
-            return std::make_pair(name, not_resolved);
+        if(results.empty() || !results[0].isMember(key))
+            return {State::NOT_RESOLVABLE, ""};
 
-        Json::Value val = results[0].get(key, not_resolved);
+        Json::Value val = results[0][key];
         if(val.isArray()){
             if(val.empty())
-                return std::make_pair(name, not_resolved);
+                return {State::NOT_RESOLVABLE, ""};
             else
-                return std::make_pair(name, val[0].asString());
+                return {State::RESOLVED, val[0].asString()};
         }
         else {
-            return std::make_pair(name, val.asString());
+            return {State::RESOLVED, val.asString()};
         }
+    } catch (const std::exception &e) {
+        // a malformed or truncated body, e.g. from a proxy, must not fail the whole query
+        Log::warn(concat("Terminology: invalid response: ", e.what()));
+        return {State::FAILED, ""};
     }
 }
 
+std::string Terminology::toResult(const std::string &name,
+                                  const TerminologyCache::Resolution &resolution,
+                                  const HandleNotResolvable on_not_resolvable) {
+    if(resolution.state == TerminologyCache::Resolution::State::RESOLVED)
+        return resolution.label;
+    return (on_not_resolvable == HandleNotResolvable::EMPTY) ? "" : name;
+}
+
 /**
- * Same method as resolveSingleNameInternal, but also return the session_ptr to the sslSession of the created HttpsClientSession.
- * @return a pair, first element is a string_pair as in resolveSingleNameInternal, second element is the Session::Ptr.
+ *
+ * @return a pair, first is the string to be resolved and the second is its resolution.
  */
-Terminology::string_session_ptr_pair
-Terminology::resolveSingleNameSetSessionPtr(Poco::Net::Context::Ptr &context,
-                                            const std::string &name,
-                                            const std::string &terminology,
-                                            const std::string &key,
-                                            const std::string &match_type,
-                                            const bool first_hit,
-                                            const HandleNotResolvable on_not_resolvable) {
-
-    std::string uri_string = Configuration::get<std::string>("terminology.url_search");
-    Poco::URI uri(uri_string);
-    uri.addQueryParameter("query", name);
-    uri.addQueryParameter("terminologies", terminology);
-    uri.addQueryParameter("match_type", match_type);
-    if(first_hit)
-        uri.addQueryParameter("first_hit", "true");
-
-    Poco::Net::HTTPSClientSession session(uri.getHost(), uri.getPort(), context);
-    Poco::Net::HTTPRequest request(Poco::Net::HTTPRequest::HTTP_GET, uri.getPathAndQuery(), Poco::Net::HTTPRequest::HTTP_1_1);
-    Poco::Net::HTTPResponse response;
+Terminology::resolution_pair Terminology::resolveSingleNameInternal(const std::string &name,
+                                                                    const TerminologyCache::Query &query)
+{
+    Poco::URI uri = searchUri(name, query);
+    const int retries = Configuration::get<int>("terminology.retries", 2);
 
-    session.sendRequest(request);
-    std::istream& respStream = session.receiveResponse(response);
-    Json::Value response_json;
+    for(int attempt = 0; ; ++attempt) {
+        auto resolution = requestResolution(uri, query.key);
+        if(resolution.state != TerminologyCache::Resolution::State::FAILED || attempt >= retries)
+            return std::make_pair(name, resolution);
 
-    if (response.getStatus() == Poco::Net::HTTPResponse::HTTP_OK)
-    {
-        respStream >> response_json;
-    } else {
-        response_json = Json::Value::null;
+        // the delay blocks a worker of the shared executor, so it is capped to keep retries from starving other queries
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::min(200L << std::min(attempt, 10), 10000L)));
     }
+}
 
-    std::string not_resolved = (on_not_resolvable == HandleNotResolvable::EMPTY) ? "" : name;
-
-    if (response_json.isNull())
-    {
-        return std::make_pair(std::make_pair(name, not_resolved), session.sslSession());
-    } else
-    {
-        Json::Value results = response_json["results"];
-        if(results.empty())
-            return std::make_pair(std::make_pair(name, not_resolved), session.sslSession());
-
-        Json::Value val = results[0].get(key, not_resolved);
-        if(val.isArray()){
-            if(val.empty())
-                return std::make_pair(std::make_pair(name, not_resolved), session.sslSession());
-            else
-                return std::make_pair(std::make_pair(name, val[0].asString()), session.sslSession());
-        }
-        else {
-            return std::make_pair(std::make_pair(name, val.asString()), session.sslSession());
+TerminologyCache::Resolution Terminology::requestResolution(const Poco::URI &uri, const std::string &key) {
+    Poco::Net::HTTPRequest request(Poco::Net::HTTPRequest::HTTP_GET, uri.getPathAndQuery(), Poco::Net::HTTPRequest::HTTP_1_1);
+    request.setKeepAlive(true);
+
+    AIMDLimiter::Permit permit(limiter());
+
+    try {
+        // the server may have closed a pooled connection meanwhile, so a request that fails on a reused connection
+        // is repeated on another one
+        while(true) {
+            bool reused = false;
+            session_ptr session = acquireSession(uri, reused);
+
+            try {
+                Poco::Net::HTTPResponse response;
+                session->sendRequest(request);
+                std::istream& respStream = session->receiveResponse(response);
+
+                auto resolution = readResolution(response, respStream, key);
+
+                // the connection can only send the next request after the whole response was read
+                respStream.ignore(std::numeric_limits<std::streamsize>::max());
+                setLastTlsSession(session->sslSession());
+                if(response.getKeepAlive())
+                    releaseSession(std::move(session));
+
+                if(resolution.state != TerminologyCache::Resolution::State::FAILED)
+                    permit.succeeded();
+                return resolution;
+            } catch (const Poco::Exception &) {
+                if(!reused)
+                    throw;
+            }
         }
+    } catch (const Poco::Exception &e) {
+        Log::warn(concat("Terminology: request to ", uri.getHost(), " failed: ", e.displayText()));
+        return {TerminologyCache::Resolution::State::FAILED, ""};
+    } catch (const std::exception &e) {
+        Log::warn(concat("Terminology: request to ", uri.getHost(), " failed: ", e.what()));
+        return {TerminologyCache::Resolution::State::FAILED, ""};
     }
 }
 
@@ -223,48 +303,17 @@ std::string Terminology::resolveSingle(const std::string &name,
                                        const bool first_hit,
                                        const HandleNotResolvable onNotResolvable)
 {
-    std::string uri_string = Configuration::get<std::string>("terminology.url_search");
-    Poco::URI uri(uri_string);
-    uri.addQueryParameter("query", name);
-    uri.addQueryParameter("terminologies", terminology);
-    uri.addQueryParameter("match_type", match_type);
-    if(first_hit)
-        uri.addQueryParameter("first_hit", "true");
-
-    Poco::Net::HTTPSClientSession session(uri.getHost(), uri.getPort());
-    Poco::Net::HTTPRequest request(Poco::Net::HTTPRequest::HTTP_GET, uri.getPathAndQuery(), Poco::Net::HTTPRequest::HTTP_1_1);
-    Poco::Net::HTTPResponse response;
-
-    session.sendRequest(request);
-    std::istream& respStream = session.receiveResponse(response);
-
-    Json::Value response_json;
-    if (response.getStatus() == Poco::Net::HTTPResponse::HTTP_OK)
-    {
-        respStream >> response_json;
-    } else {
-        response_json = Json::Value::null;
+    const TerminologyCache::Query query{terminology, key, match_type, first_hit};
+    std::set<std::string> names{name};
+    std::map<std::string, TerminologyCache::Resolution> resolutions;
+    TerminologySnapshot::resolve(query, names, resolutions);
+    TerminologyCache::Connection cache_connection;
+    TerminologyCache::get(query, names, resolutions, cache_connection);
+
+    if(resolutions.empty()) {
+        resolutions.insert(resolveSingleNameInternal(name, query));
+        TerminologyCache::put(query, resolutions, cache_connection);
     }
 
-    std::string not_resolved = (onNotResolvable == HandleNotResolvable::EMPTY) ? "" : name;
-    if (response_json.isNull())
-    {
-        return not_resolved;
-    } else
-    {
-        Json::Value results = response_json["results"];
-        if(results.empty())
-            return not_resolved;
-
-        Json::Value val = results[0].get(key, not_resolved);
-        if(val.isArray()){
-            if(val.empty())
-                return not_resolved;
-            else
-                return val[0].asString();
-        }
-        else {
-            return val.asString();
-        }
-    }
+    return toResult(name, resolutions.at(name), onNotResolvable);
 }
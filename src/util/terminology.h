@@ -2,13 +2,20 @@
 #ifndef MAPPING_CORE_TERMINOLOGY_H
 #define MAPPING_CORE_TERMINOLOGY_H
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <vector>
 #include <json/json.h>
 #include <Poco/URI.h>
 #include <Poco/Net/HTTPSClientSession.h>
 #include <Poco/Net/HTTPRequest.h>
 #include <Poco/Net/HTTPResponse.h>
 #include "datatypes/simplefeaturecollection.h"
+#include "util/fairexecutor.h"
+#include "util/terminologycache.h"
 
 enum class HandleNotResolvable {
     EMPTY,
@@ -18,6 +25,7 @@ enum class HandleNotResolvable {
 
 /**
  * Class wrapping calls to terminologies service from gfbio.
+ * Results are cached, see `TerminologyCache`.
  */
 class Terminology {
     public:
@@ -53,26 +61,88 @@ class Terminology {
                                                         const bool first_hit,
                                                         const HandleNotResolvable on_not_resolvable);
 
+        /**
+         * Resolution of names that are produced incrementally.
+         * Requests for the added names start right away, so they overlap with producing the remaining names.
+         */
+        class Pipeline {
+            public:
+                Pipeline(const std::string &terminology,
+                         const std::string &key,
+                         const std::string &match_type,
+                         bool first_hit,
+                         HandleNotResolvable on_not_resolvable);
+
+                /**
+                 * Waits for the requests that are still running
+                 */
+                ~Pipeline();
+
+                Pipeline(const Pipeline &) = delete;
+                Pipeline &operator=(const Pipeline &) = delete;
+
+                /**
+                 * Start resolving the names that were not added before, without waiting for the results
+                 */
+                void add(const std::vector<std::string> &names);
+
+                /**
+                 * Add the names and wait until they are resolved
+                 * @return vector of resolved terms, order of names preserved.
+                 */
+                std::vector<std::string> resolve(const std::vector<std::string> &names);
+
+            private:
+                const TerminologyCache::Query query;
+                const HandleNotResolvable on_not_resolvable;
+
+                /// one connection to the shared cache serves all chunks of the pipeline
+                TerminologyCache::Connection cache_connection;
+                std::set<std::string> added;
+                std::map<std::string, TerminologyCache::Resolution> resolved;
+                /// results of requests that are not in the cache yet, written by the request tasks
+                std::map<std::string, TerminologyCache::Resolution> requested;
+                std::mutex requested_mutex;
+                std::unique_ptr<FairExecutor::Group> requests;
+        };
+
     private:
-        using string_pair = std::pair<std::string, std::string>;
-        using string_session_ptr_pair = std::pair<Terminology::string_pair, Poco::Net::Session::Ptr>;
-
-        static string_session_ptr_pair resolveSingleNameSetSessionPtr(Poco::Net::Context::Ptr &context,
-                                                                      const std::string &name,
-                                                                      const std::string &terminology,
-                                                                      const std::string &key,
-                                                                      const std::string &match_type,
-                                                                      const bool first_hit,
-                                                                      const HandleNotResolvable on_not_resolvable);
-
-        static string_pair resolveSingleNameInternal(Poco::Net::Context::Ptr &context,
-                                                     Poco::Net::Session::Ptr &session_ptr,
-                                                     const std::string &name,
-                                                     const std::string &terminology,
-                                                     const std::string &key,
-                                                     const std::string &match_type,
-                                                     const bool first_hit,
-                                                     const HandleNotResolvable &on_not_resolvable);
+        using resolution_pair = std::pair<std::string, TerminologyCache::Resolution>;
+
+        /**
+         * Request a single name, failed requests are retried `terminology.retries` times with a growing delay
+         * of at most 10 seconds. The delay occupies a worker of the shared executor, so retries lower the
+         * number of requests that run concurrently.
+         */
+        static resolution_pair resolveSingleNameInternal(const std::string &name,
+                                                         const TerminologyCache::Query &query);
+
+        /**
+         * Send a single request on a keep-alive connection, limited by the adaptive concurrency limit.
+         * @return the resolution, its state is FAILED if the service did not answer in time or with an error
+         */
+        static TerminologyCache::Resolution requestResolution(const Poco::URI &uri, const std::string &key);
+
+        /**
+         * @return the uri of the search api for a name
+         */
+        static Poco::URI searchUri(const std::string &name, const TerminologyCache::Query &query);
+
+        /**
+         * Read the result of a search request
+         * @return NOT_RESOLVABLE for client errors other than timeouts and rate limits, as repeating
+         *         the request would not change the answer, and FAILED for other errors or an invalid body
+         */
+        static TerminologyCache::Resolution readResolution(Poco::Net::HTTPResponse &response,
+                                                           std::istream &response_stream,
+                                                           const std::string &key);
+
+        /**
+         * @return the label of a resolution or the replacement of names that were not resolved
+         */
+        static std::string toResult(const std::string &name,
+                                    const TerminologyCache::Resolution &resolution,
+                                    HandleNotResolvable on_not_resolvable);
 };
 
 #endif //MAPPING_CORE_TERMINOLOGY_H
@@ -0,0 +1,214 @@
+#include "terminologycache.h"
+
+#include "util/lrucache.h"
+#include "util/configuration.h"
+#include "util/concat.h"
+#include "util/log.h"
+
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include <pqxx/pqxx>
+
+using clock_type = std::chrono::steady_clock;
+
+namespace {
+    struct CachedResolution {
+        TerminologyCache::Resolution resolution;
+        clock_type::time_point expires;
+    };
+}
+
+static LRUCache<std::string, CachedResolution> &memoryCache() {
+    static LRUCache<std::string, CachedResolution> cache(
+            Configuration::get<size_t>("terminology.cache.capacity", 100000)
+    );
+    return cache;
+}
+
+static std::string toArrayLiteral(const std::set<std::string> &values) {
+    std::stringstream array;
+    array << "{";
+    for (auto it = values.begin(); it != values.end(); ++it) {
+        if (it != values.begin()) {
+            array << ",";
+        }
+        array << "\"";
+        for (char c : *it) {
+            if (c == '"' || c == '\\') {
+                array << '\\';
+            }
+            array << c;
+        }
+        array << "\"";
+    }
+    array << "}";
+    return array.str();
+}
+
+static void prepareTable(pqxx::connection &connection) {
+    static std::once_flag prepared;
+    std::call_once(prepared, [&connection] {
+        pqxx::work work(connection);
+        work.exec("CREATE TABLE IF NOT EXISTS terminology_cache (terminology text NOT NULL, key text NOT NULL, "
+                  "match_type text NOT NULL, first_hit boolean NOT NULL, name text NOT NULL, resolved boolean NOT NULL, "
+                  "label text NOT NULL, expires timestamptz NOT NULL, PRIMARY KEY (terminology, key, match_type, first_hit, name))");
+        work.exec("DELETE FROM terminology_cache WHERE expires < now()");
+        work.commit();
+    });
+}
+
+struct TerminologyCache::Connection::State {
+    std::unique_ptr<pqxx::connection> connection;
+    bool failed = false;
+
+    /**
+     * @return the open connection or nullptr if the shared cache is not configured or unreachable
+     */
+    pqxx::connection *get() {
+        if (connection || failed) {
+            return connection.get();
+        }
+
+        const std::string credentials = Configuration::get<std::string>("terminology.cache.dbcredentials", "");
+        if (credentials.empty()) {
+            failed = true;
+            return nullptr;
+        }
+
+        try {
+            connection.reset(new pqxx::connection(credentials));
+            prepareTable(*connection);
+            connection->prepare("terminologyCacheGet", "SELECT name, resolved, label, extract(epoch FROM expires - now()) "
+                    "FROM terminology_cache WHERE terminology = $1 AND key = $2 AND match_type = $3 AND first_hit = $4 "
+                    "AND name = ANY($5) AND expires > now()");
+            connection->prepare("terminologyCachePut", "INSERT INTO terminology_cache VALUES ($1, $2, $3, $4, $5, $6, $7, "
+                    "now() + $8 * interval '1 second') ON CONFLICT (terminology, key, match_type, first_hit, name) "
+                    "DO UPDATE SET resolved = excluded.resolved, label = excluded.label, expires = excluded.expires");
+        } catch (const std::exception &e) {
+            Log::debug(concat("TerminologyCache: could not connect to the shared cache: ", e.what()));
+            connection.reset();
+            failed = true;
+        }
+        return connection.get();
+    }
+};
+
+TerminologyCache::Connection::Connection() : state(new State()) {}
+
+TerminologyCache::Connection::~Connection() = default;
+
+std::string TerminologyCache::memoryKey(const Query &query, const std::string &name) {
+    return concat(query.terminology, '\0', query.key, '\0', query.matchType, '\0', query.firstHit, '\0', name);
+}
+
+void TerminologyCache::get(const Query &query, std::set<std::string> &names, std::map<std::string, Resolution> &resolutions) {
+    Connection connection;
+    get(query, names, resolutions, connection);
+}
+
+void TerminologyCache::get(const Query &query, std::set<std::string> &names, std::map<std::string, Resolution> &resolutions,
+                           Connection &connection) {
+    const auto now = clock_type::now();
+
+    for (auto it = names.begin(); it != names.end();) {
+        const std::string key = memoryKey(query, *it);
+        CachedResolution cached;
+        if (memoryCache().get(key, cached)) {
+            if (cached.expires > now) {
+                resolutions[*it] = cached.resolution;
+                it = names.erase(it);
+                continue;
+            }
+            memoryCache().remove(key);
+        }
+        ++it;
+    }
+
+    if (names.empty()) {
+        return;
+    }
+    pqxx::connection *sharedCache = connection.state->get();
+    if (sharedCache == nullptr) {
+        return;
+    }
+
+    // the shared cache is best effort, names missing in it are resolved by the terminology service
+    try {
+        pqxx::work work(*sharedCache);
+        pqxx::result result = work.prepared("terminologyCacheGet")(query.terminology)(query.key)(query.matchType)
+                (query.firstHit)(toArrayLiteral(names)).exec();
+        work.commit();
+
+        for (size_t i = 0; i < result.size(); ++i) {
+            const std::string name = result[i][0].as<std::string>();
+            Resolution resolution{result[i][1].as<bool>() ? Resolution::State::RESOLVED : Resolution::State::NOT_RESOLVABLE,
+                                  result[i][2].as<std::string>()};
+            auto remaining = std::chrono::seconds(static_cast<long>(result[i][3].as<double>()));
+
+            memoryCache().put(memoryKey(query, name), CachedResolution{resolution, now + remaining});
+            resolutions[name] = resolution;
+            names.erase(name);
+        }
+    } catch (const std::exception &e) {
+        Log::debug(concat("TerminologyCache: could not read from the shared cache: ", e.what()));
+    }
+}
+
+void TerminologyCache::put(const Query &query, const std::map<std::string, Resolution> &resolutions) {
+    Connection connection;
+    put(query, resolutions, connection);
+}
+
+void TerminologyCache::put(const Query &query, const std::map<std::string, Resolution> &resolutions, Connection &connection) {
+    const long positiveTTL = Configuration::get<long>("terminology.cache.ttl", 86400);
+    const long negativeTTL = Configuration::get<long>("terminology.cache.negative_ttl", 3600);
+    const long failureTTL = Configuration::get<long>("terminology.cache.failure_ttl", 30);
+    const auto now = clock_type::now();
+
+    std::vector<std::pair<std::string, long>> stored;
+    for (auto &entry : resolutions) {
+        long ttl;
+        switch (entry.second.state) {
+            case Resolution::State::RESOLVED:
+                ttl = positiveTTL;
+                break;
+            case Resolution::State::NOT_RESOLVABLE:
+                ttl = negativeTTL;
+                break;
+            default:
+                ttl = failureTTL;
+        }
+        if (ttl <= 0) {
+            continue;
+        }
+
+        memoryCache().put(memoryKey(query, entry.first), CachedResolution{entry.second, now + std::chrono::seconds(ttl)});
+
+        // failures are transient and specific to this process
+        if (entry.second.state != Resolution::State::FAILED) {
+            stored.emplace_back(entry.first, ttl);
+        }
+    }
+
+    if (stored.empty()) {
+        return;
+    }
+    pqxx::connection *sharedCache = connection.state->get();
+    if (sharedCache == nullptr) {
+        return;
+    }
+
+    try {
+        pqxx::work work(*sharedCache);
+        for (auto &entry : stored) {
+            const Resolution &resolution = resolutions.at(entry.first);
+            work.prepared("terminologyCachePut")(query.terminology)(query.key)(query.matchType)(query.firstHit)
+                    (entry.first)(resolution.state == Resolution::State::RESOLVED)(resolution.label)(entry.second).exec();
+        }
+        work.commit();
+    } catch (const std::exception &e) {
+        Log::debug(concat("TerminologyCache: could not write to the shared cache: ", e.what()));
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef UTIL_TERMINOLOGYCACHE_H_
+#define UTIL_TERMINOLOGYCACHE_H_
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+/**
+ * Two-tiered cache for the results of the terminology search api.
+ *
+ * Results are kept in a process-wide in-memory LRU cache and, if `terminology.cache.dbcredentials`
+ * is configured, additionally in a PostgreSQL table so that they survive restarts and are shared between processes.
+ * Names that could not be resolved are cached as well, but expire after `terminology.cache.negative_ttl`.
+ * Failed requests are kept in memory for `terminology.cache.failure_ttl`, so a struggling service is not asked
+ * for the same names again right away.
+ */
+class TerminologyCache {
+    public:
+        /**
+         * The parameters of a search request besides the name
+         */
+        struct Query {
+            std::string terminology;
+            std::string key;
+            std::string matchType;
+            bool firstHit;
+        };
+
+        /**
+         * The outcome of resolving a name
+         */
+        struct Resolution {
+            enum class State {
+                RESOLVED, NOT_RESOLVABLE, FAILED
+            };
+
+            State state;
+            std::string label;
+        };
+
+        /**
+         * A connection to the shared cache, opened on first use and reused by the lookups passed it
+         */
+        class Connection {
+            public:
+                Connection();
+                ~Connection();
+
+                Connection(const Connection &) = delete;
+                Connection &operator=(const Connection &) = delete;
+
+            private:
+                friend class TerminologyCache;
+
+                struct State;
+                std::unique_ptr<State> state;
+        };
+
+        /**
+         * Look up the cached resolutions of names
+         * @param names the names to look up, found names are removed
+         * @param resolutions the found resolutions are inserted here
+         */
+        static void get(const Query &query, std::set<std::string> &names, std::map<std::string, Resolution> &resolutions);
+
+        /**
+         * Look up the cached resolutions of names, using the given connection for the shared cache
+         */
+        static void get(const Query &query, std::set<std::string> &names, std::map<std::string, Resolution> &resolutions,
+                        Connection &connection);
+
+        /**
+         * Store resolutions, failed resolutions are only stored in memory
+         */
+        static void put(const Query &query, const std::map<std::string, Resolution> &resolutions);
+
+        /**
+         * Store resolutions, using the given connection for the shared cache
+         */
+        static void put(const Query &query, const std::map<std::string, Resolution> &resolutions, Connection &connection);
+
+    private:
+        static std::string memoryKey(const Query &query, const std::string &name);
+};
+
+#endif /* UTIL_TERMINOLOGYCACHE_H_ */
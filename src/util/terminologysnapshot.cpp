@@ -0,0 +1,366 @@
+#include "terminologysnapshot.h"
+
+#include "util/configuration.h"
+#include "util/concat.h"
+#include "util/curlstream.h"
+#include "util/jsonscanner.h"
+#include "util/log.h"
+#include "util/stringsplit.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+static const char MAGIC[8] = "TSNAP01";
+
+/**
+ * the members of a term whose values are searched
+ */
+static const std::set<std::string> NAME_MEMBERS = {"label", "synonyms", "commonNames"};
+
+static std::string toLower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(), [](char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    });
+    return value;
+}
+
+/**
+ * @return the strings of the value at the current position, the elements if it is an array
+ */
+static std::vector<std::string> scanStrings(JsonScanner &scanner) {
+    std::vector<std::string> strings;
+    auto scanScalar = [&scanner, &strings]() {
+        if (scanner.peek() == '"') {
+            strings.push_back(scanner.parseString());
+            return;
+        }
+        Json::Value value = scanner.parseValue();
+        if (value.isConvertibleTo(Json::stringValue) && !value.isNull()) {
+            strings.push_back(value.asString());
+        }
+    };
+
+    if (scanner.peek() == '[') {
+        scanner.forEachElement([&scanner, &scanScalar]() {
+            if (scanner.peek() == '[' || scanner.peek() == '{') {
+                scanner.skipValue();
+            } else {
+                scanScalar();
+            }
+        });
+    } else if (scanner.peek() == '{') {
+        scanner.skipValue();
+    } else {
+        scanScalar();
+    }
+    return strings;
+}
+
+std::string TerminologySnapshot::path(const std::string &terminology) {
+    const std::string directory = Configuration::get<std::string>("terminology.snapshot.directory", "");
+    if (directory.empty()) {
+        return "";
+    }
+
+    if (terminology.empty() || terminology.find_first_not_of(
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_-") != std::string::npos) {
+        throw std::runtime_error(concat("TerminologySnapshot: invalid terminology name ", terminology));
+    }
+
+    return concat(directory, "/", terminology, ".snapshot");
+}
+
+size_t TerminologySnapshot::import(const std::string &terminology) {
+    std::string url = Configuration::get<std::string>("terminology.url_allterms",
+                                                      "https://terminologies.gfbio.org/api/terminologies/{terminology}/allterms");
+    const std::string placeholder = "{terminology}";
+    size_t position = url.find(placeholder);
+    if (position != std::string::npos) {
+        url.replace(position, placeholder.size(), terminology);
+    }
+
+    cURLInputStream stream(url);
+    std::string document((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    stream.checkTransfer();
+
+    return import(terminology, document);
+}
+
+size_t TerminologySnapshot::import(const std::string &terminology, const std::string &document) {
+    const std::string snapshotPath = path(terminology);
+    if (snapshotPath.empty()) {
+        throw std::runtime_error("TerminologySnapshot: terminology.snapshot.directory is not configured");
+    }
+
+    size_t termCount = write(snapshotPath, document,
+                             split(Configuration::get<std::string>("terminology.snapshot.keys", "label,uri"), ','));
+
+    Log::info(concat("TerminologySnapshot: imported ", termCount, " terms of ", terminology));
+    return termCount;
+}
+
+size_t TerminologySnapshot::write(const std::string &snapshotPath, const std::string &document,
+                                  const std::vector<std::string> &storedKeys) {
+    std::vector<std::string> keys;
+    for (auto &key : storedKeys) {
+        if (!key.empty() && std::find(keys.begin(), keys.end(), key) == keys.end()) {
+            keys.push_back(key);
+        }
+    }
+
+    // all strings are appended to one blob, the tables refer to it
+    std::string strings;
+    auto addString = [&strings](const std::string &value) {
+        StringRef ref{strings.size(), value.size()};
+        strings += value;
+        return ref;
+    };
+
+    std::vector<StringRef> keyRefs;
+    for (auto &key : keys) {
+        keyRefs.push_back(addString(key));
+    }
+
+    std::vector<StringRef> values;
+    std::vector<std::pair<std::string, uint64_t>> termNames;
+    uint64_t termCount = 0;
+
+    JsonScanner scanner(document);
+    scanner.forEachMember([&](const std::string &member) {
+        if (member != "results" || scanner.peek() != '[') {
+            scanner.skipValue();
+            return;
+        }
+
+        scanner.forEachElement([&]() {
+            if (scanner.peek() != '{') {
+                scanner.skipValue();
+                return;
+            }
+
+            std::vector<std::string> termValues(keys.size());
+            scanner.forEachMember([&](const std::string &termMember) {
+                auto key = std::find(keys.begin(), keys.end(), termMember);
+                bool isName = NAME_MEMBERS.count(termMember) > 0;
+                if (key == keys.end() && !isName) {
+                    scanner.skipValue();
+                    return;
+                }
+
+                std::vector<std::string> memberStrings = scanStrings(scanner);
+                // like the search api, the first element of an array is the result
+                if (key != keys.end() && !memberStrings.empty()) {
+                    termValues[key - keys.begin()] = memberStrings.front();
+                }
+                if (isName) {
+                    for (auto &name : memberStrings) {
+                        termNames.emplace_back(toLower(name), termCount);
+                    }
+                }
+            });
+
+            for (auto &value : termValues) {
+                values.push_back(addString(value));
+            }
+            ++termCount;
+        });
+    });
+    scanner.expectEnd();
+
+    std::sort(termNames.begin(), termNames.end());
+    termNames.erase(std::unique(termNames.begin(), termNames.end()), termNames.end());
+
+    std::vector<NameEntry> names;
+    names.reserve(termNames.size());
+    for (auto &termName : termNames) {
+        names.push_back(NameEntry{addString(termName.first), termName.second});
+    }
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.keyCount = keys.size();
+    header.termCount = termCount;
+    header.nameCount = names.size();
+    header.keysOffset = sizeof(Header);
+    header.valuesOffset = header.keysOffset + keyRefs.size() * sizeof(StringRef);
+    header.namesOffset = header.valuesOffset + values.size() * sizeof(StringRef);
+    header.stringsOffset = header.namesOffset + names.size() * sizeof(NameEntry);
+    header.size = header.stringsOffset + strings.size();
+
+    // write to a temporary file first, so that readers never see a partial snapshot
+    const std::string temporaryPath = concat(snapshotPath, ".", getpid(), ".tmp");
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(keyRefs.data()), keyRefs.size() * sizeof(StringRef));
+        file.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(StringRef));
+        file.write(reinterpret_cast<const char *>(names.data()), names.size() * sizeof(NameEntry));
+        file.write(strings.data(), strings.size());
+        if (!file) {
+            std::remove(temporaryPath.c_str());
+            throw std::runtime_error(concat("TerminologySnapshot: could not write ", temporaryPath));
+        }
+    }
+
+    if (std::rename(temporaryPath.c_str(), snapshotPath.c_str()) != 0) {
+        std::remove(temporaryPath.c_str());
+        throw std::runtime_error(concat("TerminologySnapshot: could not store ", snapshotPath));
+    }
+
+    return termCount;
+}
+
+TerminologySnapshot::TerminologySnapshot(const std::string &path) : data(nullptr), size(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error(concat("TerminologySnapshot: could not open ", path));
+    }
+
+    struct stat status{};
+    if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(Header)) {
+        close(fd);
+        throw std::runtime_error(concat("TerminologySnapshot: invalid file ", path));
+    }
+    size = status.st_size;
+
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error(concat("TerminologySnapshot: could not map ", path));
+    }
+    data = static_cast<const char *>(mapping);
+
+    header = reinterpret_cast<const Header *>(data);
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->size != size
+        || header->keysOffset != sizeof(Header)
+        || header->valuesOffset != header->keysOffset + header->keyCount * sizeof(StringRef)
+        || header->namesOffset != header->valuesOffset + header->termCount * header->keyCount * sizeof(StringRef)
+        || header->stringsOffset != header->namesOffset + header->nameCount * sizeof(NameEntry)
+        || header->stringsOffset > size) {
+        munmap(const_cast<char *>(data), size);
+        throw std::runtime_error(concat("TerminologySnapshot: invalid file ", path));
+    }
+
+    keys = reinterpret_cast<const StringRef *>(data + header->keysOffset);
+    values = reinterpret_cast<const StringRef *>(data + header->valuesOffset);
+    names = reinterpret_cast<const NameEntry *>(data + header->namesOffset);
+    strings = data + header->stringsOffset;
+}
+
+TerminologySnapshot::~TerminologySnapshot() {
+    munmap(const_cast<char *>(data), size);
+}
+
+std::shared_ptr<const TerminologySnapshot> TerminologySnapshot::load(const std::string &terminology) {
+    struct LoadedSnapshot {
+        std::shared_ptr<const TerminologySnapshot> snapshot;
+        time_t modified;
+        off_t size;
+    };
+    static std::mutex mutex;
+    static std::map<std::string, LoadedSnapshot> loaded;
+
+    const std::string snapshotPath = path(terminology);
+    if (snapshotPath.empty()) {
+        return nullptr;
+    }
+
+    struct stat status{};
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stat(snapshotPath.c_str(), &status) != 0) {
+        loaded.erase(terminology);
+        return nullptr;
+    }
+
+    // another process may have imported a new snapshot
+    auto it = loaded.find(terminology);
+    if (it != loaded.end() && it->second.modified == status.st_mtime && it->second.size == status.st_size) {
+        return it->second.snapshot;
+    }
+
+    std::shared_ptr<const TerminologySnapshot> snapshot(new TerminologySnapshot(snapshotPath));
+    loaded[terminology] = LoadedSnapshot{snapshot, status.st_mtime, status.st_size};
+    return snapshot;
+}
+
+std::string TerminologySnapshot::getString(const StringRef &ref) const {
+    return std::string(strings + ref.offset, ref.length);
+}
+
+int64_t TerminologySnapshot::findKey(const std::string &key) const {
+    for (uint64_t i = 0; i < header->keyCount; ++i) {
+        if (keys[i].length == key.size() && std::memcmp(strings + keys[i].offset, key.data(), key.size()) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint64_t TerminologySnapshot::findExact(const std::string &name) const {
+    // the names are sorted by name and term, so the first equal entry has the first term
+    auto entry = std::lower_bound(names, names + header->nameCount, name, [this](const NameEntry &entry, const std::string &name) {
+        int comparison = std::memcmp(strings + entry.name.offset, name.data(), std::min<size_t>(entry.name.length, name.size()));
+        return comparison < 0 || (comparison == 0 && entry.name.length < name.size());
+    });
+
+    if (entry == names + header->nameCount || entry->name.length != name.size()
+        || std::memcmp(strings + entry->name.offset, name.data(), name.size()) != 0) {
+        return NO_TERM;
+    }
+    return entry->term;
+}
+
+void TerminologySnapshot::resolve(const TerminologyCache::Query &query, std::set<std::string> &names,
+                                  std::map<std::string, TerminologyCache::Resolution> &resolutions) {
+    std::shared_ptr<const TerminologySnapshot> snapshot;
+    try {
+        snapshot = load(query.terminology);
+    } catch (const std::exception &e) {
+        Log::warn(e.what());
+    }
+    if (!snapshot) {
+        return;
+    }
+
+    snapshot->resolve(query, names, resolutions, Configuration::get<bool>("terminology.snapshot.remote_fallback", true));
+}
+
+void TerminologySnapshot::resolve(const TerminologyCache::Query &query, std::set<std::string> &names,
+                                  std::map<std::string, TerminologyCache::Resolution> &resolutions,
+                                  bool remoteFallback) const {
+    using State = TerminologyCache::Resolution::State;
+
+    // only exact matches are answered locally. Searching the included or regex matches of a name would scan
+    // every stored name, so these queries are left to the service.
+    const int64_t key = findKey(query.key);
+    if (key < 0 || query.matchType != "exact") {
+        return;
+    }
+
+    for (auto it = names.begin(); it != names.end();) {
+        const uint64_t term = findExact(toLower(*it));
+
+        if (term != NO_TERM) {
+            std::string label = getString(values[term * header->keyCount + key]);
+            resolutions[*it] = label.empty() ? TerminologyCache::Resolution{State::NOT_RESOLVABLE, ""}
+                                             : TerminologyCache::Resolution{State::RESOLVED, label};
+            it = names.erase(it);
+        } else if (!remoteFallback) {
+            resolutions[*it] = {State::NOT_RESOLVABLE, ""};
+            it = names.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
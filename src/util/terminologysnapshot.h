@@ -0,0 +1,123 @@
+#ifndef UTIL_TERMINOLOGYSNAPSHOT_H_
+#define UTIL_TERMINOLOGYSNAPSHOT_H_
+
+#include "util/terminologycache.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * A local, memory-mapped copy of the terms of a terminology.
+ *
+ * Snapshots are imported into `terminology.snapshot.directory` and answer exact searches for the labels, synonyms
+ * and common names of the terms without network round trips, using binary search on the sorted names. Names are
+ * compared ignoring ASCII case. Only the result keys listed in `terminology.snapshot.keys` are stored.
+ * Searches with the match types `included` and `regex` are always sent to the terminology service.
+ */
+class TerminologySnapshot {
+    public:
+        /**
+         * Map a snapshot file
+         */
+        explicit TerminologySnapshot(const std::string &path);
+
+        ~TerminologySnapshot();
+
+        TerminologySnapshot(const TerminologySnapshot &) = delete;
+        TerminologySnapshot &operator=(const TerminologySnapshot &) = delete;
+
+        /**
+         * Build the snapshot of a terminology from a JSON document with the terms in its `results` array,
+         * as returned by the `allterms` api. An existing snapshot is replaced atomically.
+         * @return the number of imported terms
+         */
+        static size_t import(const std::string &terminology, const std::string &document);
+
+        /**
+         * Download the terms of a terminology from `terminology.url_allterms` and import them
+         */
+        static size_t import(const std::string &terminology);
+
+        /**
+         * Resolve names with the snapshot of the query's terminology, if there is one that stores the query's key
+         * and the query's match type is `exact`. Names without a match are not resolvable if
+         * `terminology.snapshot.remote_fallback` is false, otherwise they are left for the terminology service.
+         * @param names the names to resolve, resolved names are removed
+         * @param resolutions the resolutions are inserted here
+         */
+        static void resolve(const TerminologyCache::Query &query, std::set<std::string> &names,
+                            std::map<std::string, TerminologyCache::Resolution> &resolutions);
+
+        /**
+         * Write a snapshot file from a JSON document with the terms in its `results` array
+         * @param keys the result keys to store
+         * @return the number of terms
+         */
+        static size_t write(const std::string &path, const std::string &document, const std::vector<std::string> &keys);
+
+        /**
+         * Resolve names with this snapshot, if it stores the query's key and the match type is `exact`
+         * @param remoteFallback whether names without a match are left for the terminology service
+         *        instead of being not resolvable
+         */
+        void resolve(const TerminologyCache::Query &query, std::set<std::string> &names,
+                     std::map<std::string, TerminologyCache::Resolution> &resolutions, bool remoteFallback) const;
+
+    private:
+        struct StringRef {
+            uint64_t offset;
+            uint64_t length;
+        };
+
+        struct NameEntry {
+            StringRef name;
+            uint64_t term;
+        };
+
+        struct Header {
+            char magic[8];
+            uint64_t keyCount;
+            uint64_t termCount;
+            uint64_t nameCount;
+            uint64_t keysOffset;
+            uint64_t valuesOffset;
+            uint64_t namesOffset;
+            uint64_t stringsOffset;
+            uint64_t size;
+        };
+
+        static constexpr uint64_t NO_TERM = UINT64_MAX;
+
+        /**
+         * @return the current snapshot of a terminology or nullptr if it has none
+         */
+        static std::shared_ptr<const TerminologySnapshot> load(const std::string &terminology);
+
+        static std::string path(const std::string &terminology);
+
+        std::string getString(const StringRef &ref) const;
+
+        /**
+         * @return the index of a key or -1 if it is not stored
+         */
+        int64_t findKey(const std::string &key) const;
+
+        /**
+         * @return the first term in import order that matches the lower case name, NO_TERM if none matches
+         */
+        uint64_t findExact(const std::string &name) const;
+
+        const char *data;
+        size_t size;
+        const Header *header;
+        const StringRef *keys;
+        const StringRef *values;
+        const NameEntry *names;
+        const char *strings;
+};
+
+#endif /* UTIL_TERMINOLOGYSNAPSHOT_H_ */
@@ -0,0 +1,98 @@
+#include "tilecache.h"
+
+#include "util/lrucache.h"
+#include "util/configuration.h"
+#include "util/concat.h"
+#include "util/sha1.h"
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static LRUCache<std::string, std::string> &memoryCache() {
+	static LRUCache<std::string, std::string> cache(
+			Configuration::get<size_t>("gfbio.tiles.cache.capacity", 1024),
+			std::chrono::seconds(Configuration::get<long>("gfbio.tiles.cache.ttl", 86400))
+	);
+	return cache;
+}
+
+std::string TileCache::key(const std::string &source, int z, int x, int y) {
+	SHA1 hasher;
+	hasher.addBytes(concat(source, "/", z, "/", x, "/", y));
+	return hasher.digest().asHex();
+}
+
+std::string TileCache::diskPath(const std::string &key) {
+	std::string directory = Configuration::get<std::string>("gfbio.tiles.cache.directory", "");
+	if (directory.empty()) {
+		return "";
+	}
+
+	return concat(directory, "/", key, ".mvt");
+}
+
+bool TileCache::get(const std::string &key, std::string &tile) {
+	if (memoryCache().get(key, tile)) {
+		return true;
+	}
+
+	std::string path = diskPath(key);
+	if (path.empty()) {
+		return false;
+	}
+
+	struct stat status{};
+	if (stat(path.c_str(), &status) != 0) {
+		return false;
+	}
+
+	long ttl = Configuration::get<long>("gfbio.tiles.cache.ttl", 86400);
+	if (ttl > 0 && std::time(nullptr) - status.st_mtime > ttl) {
+		std::remove(path.c_str());
+		return false;
+	}
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	std::stringstream data;
+	data << file.rdbuf();
+	tile = data.str();
+
+	memoryCache().put(key, tile);
+
+	return true;
+}
+
+void TileCache::put(const std::string &key, const std::string &tile) {
+	memoryCache().put(key, tile);
+
+	std::string path = diskPath(key);
+	if (path.empty()) {
+		return;
+	}
+
+	// write to a temporary file first, so that concurrent readers never see partial tiles
+	std::string temporaryPath = concat(path, ".", getpid(), ".tmp");
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			return;
+		}
+		file.write(tile.data(), tile.size());
+		if (!file) {
+			std::remove(temporaryPath.c_str());
+			return;
+		}
+	}
+
+	if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+		std::remove(temporaryPath.c_str());
+	}
+}
@@ -0,0 +1,31 @@
+#ifndef UTIL_TILECACHE_H_
+#define UTIL_TILECACHE_H_
+
+#include <string>
+
+/**
+ * Two-tiered cache for encoded map tiles.
+ *
+ * Tiles are kept in a process-wide in-memory LRU cache and, if `gfbio.tiles.cache.directory`
+ * is configured, additionally on disk so that they survive restarts and are shared between processes.
+ */
+class TileCache {
+public:
+	/**
+	 * Build a cache key from the parameters that identify a tile
+	 * @param source a string that uniquely describes the tile source, e.g. its query parameters
+	 */
+	static std::string key(const std::string &source, int z, int x, int y);
+
+	/**
+	 * @return true iff the tile was found and copied to `tile`
+	 */
+	static bool get(const std::string &key, std::string &tile);
+
+	static void put(const std::string &key, const std::string &tile);
+
+private:
+	static std::string diskPath(const std::string &key);
+};
+
+#endif /* UTIL_TILECACHE_H_ */
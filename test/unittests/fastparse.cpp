@@ -0,0 +1,55 @@
+#include "util/fastparse.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+static double parseWithStrtod(const std::string &field) {
+    if (field.empty()) {
+        return NAN;
+    }
+    char *end;
+    double value = std::strtod(field.c_str(), &end);
+    return end == field.c_str() + field.size() ? value : NAN;
+}
+
+TEST(FastParse, parseDoubleMatchesStrtod) {
+    std::vector<std::string> fields = {"0", "-0", "+1", "1.", ".5", "1e5", "1E-5", "-12.75", "1e22", "1e23", "1e-23",
+                                       "0.1", "3.14159265358979323846", "9007199254740993", "123456789012345678901",
+                                       "1e400", "nan", "inf", "1e", "-", ".", "1,5", "12abc", " 1", "1 ",
+                                       std::string(70, '0') + "12.5", "1." + std::string(80, '3'),
+                                       std::string(100, '1') + "x"};
+
+    std::mt19937_64 random(42);
+    char buffer[64];
+    for (int i = 0; i < 100000; ++i) {
+        double value = std::ldexp(static_cast<double>(random() >> 11), static_cast<int>(random() % 200) - 100);
+        snprintf(buffer, sizeof(buffer), i % 2 == 0 ? "%.17g" : "%.6f", i % 3 == 0 ? -value : value);
+        fields.emplace_back(buffer);
+    }
+
+    for (auto &field : fields) {
+        double expected = parseWithStrtod(field);
+        double actual = FastParse::parseDouble(field.data(), field.size());
+        if (std::isnan(expected)) {
+            EXPECT_TRUE(std::isnan(actual)) << field;
+        } else {
+            EXPECT_EQ(expected, actual) << field;
+        }
+    }
+}
+
+TEST(FastParse, findMatchesLinearScan) {
+    std::string text(100, 'x');
+    for (size_t position = 0; position < text.size(); ++position) {
+        std::string haystack = text;
+        haystack[position] = '\t';
+        for (size_t begin = 0; begin < haystack.size(); begin += 7) {
+            const char *expected = position >= begin ? haystack.data() + position : haystack.data() + haystack.size();
+            EXPECT_EQ(FastParse::find(haystack.data() + begin, haystack.data() + haystack.size(), '\t'), expected);
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#include "util/gfbiodatautil.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+TEST(GFBioDataUtil, projectionColumnsStartWithTheQueryColumns) {
+    std::vector<std::string> columns = GFBioDataUtil::getGBIFProjectionColumns({"countrycode", "species"});
+
+    std::vector<std::string> expected {"taxonkey", "decimallongitude", "decimallatitude", "eventdate", "countrycode", "species"};
+    EXPECT_EQ(expected, columns);
+}
+
+TEST(GFBioDataUtil, projectionColumnsDoNotRepeatQueryColumns) {
+    // a hot set that contains columns every query reads must not duplicate them in the projection
+    std::vector<std::string> columns = GFBioDataUtil::getGBIFProjectionColumns({"eventdate", "species", "taxonkey"});
+
+    std::vector<std::string> expected {"taxonkey", "decimallongitude", "decimallatitude", "eventdate", "species"};
+    EXPECT_EQ(expected, columns);
+}
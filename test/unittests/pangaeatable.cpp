@@ -0,0 +1,298 @@
+#include "util/pangaeatable.h"
+#include "util/csv_source_util.h"
+#include "datatypes/pointcollection.h"
+#include "operators/queryrectangle.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <unordered_set>
+
+static std::vector<PangaeaAPI::Parameter> createParameters(const std::vector<std::pair<std::string, std::string>> &columns) {
+    std::vector<PangaeaAPI::Parameter> parameters;
+    std::unordered_set<std::string> usedNames;
+    for (auto &column : columns) {
+        parameters.emplace_back(column.first, false, "", column.second, usedNames);
+    }
+    return parameters;
+}
+
+/**
+ * Expect equal values or both NaN
+ */
+static void expectSameNumber(double expected, double actual, size_t row) {
+    if (std::isnan(expected)) {
+        EXPECT_TRUE(std::isnan(actual)) << "row " << row;
+    } else {
+        EXPECT_EQ(expected, actual) << "row " << row;
+    }
+}
+
+TEST(PangaeaTable, matchesCSVSourceUtil) {
+    auto parameters = createParameters({{"Event", ""}, {"LATITUDE", "deg"}, {"LONGITUDE", "deg"}, {"Depth", "m"}});
+
+    std::stringstream rows;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> coordinate(-90, 90);
+    for (int i = 0; i < 1000; ++i) {
+        rows.precision(3 + i % 15);
+        rows << "PS" << i << "\t" << coordinate(random) << "\t" << coordinate(random) * 2 << "\t"
+             << (i % 4 == 0 ? "+" : "") << coordinate(random) * 1e3 << (i % 5 == 0 ? "e-2" : "") << "\n";
+    }
+    const std::string data = rows.str();
+
+    std::istringstream textfile(data);
+    PangaeaTable table(parameters);
+    table.parse(textfile);
+    ASSERT_EQ(table.getRowCount(), 1000);
+
+    Json::Value params(Json::objectValue);
+    params["separator"] = "\t";
+    params["geometry"] = "xy";
+    params["time"] = "none";
+    params["columns"]["x"] = "LONGITUDE";
+    params["columns"]["y"] = "LATITUDE";
+    params["columns"]["numeric"].append("Depth");
+    params["columns"]["textual"].append("Event");
+    CSVSourceUtil csvUtil(params);
+
+    std::istringstream csv("\"Event\"\t\"LATITUDE\"\t\"LONGITUDE\"\t\"Depth\"\n" + data);
+    QueryRectangle rect(SpatialReference(CrsId::wgs84(), -180, -90, 180, 90), TemporalReference(TIMETYPE_UNIX, 0, 1),
+                        QueryResolution::none());
+    auto points = csvUtil.getPointCollection(csv, rect);
+    ASSERT_EQ(points->getFeatureCount(), 1000);
+
+    auto columns = table.getColumns();
+    for (size_t row = 0; row < 1000; ++row) {
+        EXPECT_EQ(columns[0].getText(row), points->feature_attributes.textual("Event").get(row));
+        EXPECT_EQ(columns[1].getNumeric(row), points->coordinates[row].y);
+        EXPECT_EQ(columns[2].getNumeric(row), points->coordinates[row].x);
+        EXPECT_EQ(columns[3].getNumeric(row), points->feature_attributes.numeric("Depth").get(row));
+    }
+}
+
+TEST(PangaeaTable, projectedParsingMatchesFullParsing) {
+    auto parameters = createParameters({{"Event", ""}, {"LATITUDE", "deg"}, {"LONGITUDE", "deg"}, {"Depth", "m"}, {"Comment", ""}});
+
+    std::stringstream rows;
+    std::mt19937 random(5);
+    for (int i = 0; i < 3000; ++i) {
+        rows << "PS" << i << "\t" << random() % 1800 / 10.0 - 90 << "\t" << random() % 3600 / 10.0 - 180;
+        if (i % 9 != 0) {
+            rows << "\t" << (i % 4 == 0 ? "" : std::to_string(random() % 10000 / 3.0)) << "\t" << std::string(random() % 50, 'c');
+        }
+        rows << (i % 6 == 0 ? "\r\n" : "\n");
+    }
+    const std::string data = rows.str();
+
+    std::istringstream textfile(data);
+    PangaeaTable full(parameters);
+    full.parse(textfile, 1);
+
+    for (auto &projection : std::vector<std::set<std::string>>{{"LATITUDE", "LONGITUDE"}, {"Event", "Depth"}, {"Depth"}, {"Comment"}}) {
+        for (size_t threads : {1, 4}) {
+            std::istringstream projectedTextfile(data);
+            PangaeaTable projected(parameters, projection);
+            projected.parse(projectedTextfile, threads, 4096);
+            ASSERT_EQ(projected.getRowCount(), full.getRowCount());
+
+            auto fullColumns = full.getColumns();
+            auto projectedColumns = projected.getColumns();
+            ASSERT_EQ(projectedColumns.size(), projection.size());
+            for (auto &projectedColumn : projectedColumns) {
+                ASSERT_EQ(projection.count(projectedColumn.name), 1);
+                auto fullColumn = std::find_if(fullColumns.begin(), fullColumns.end(), [&](const PangaeaColumn &column) {
+                    return column.name == projectedColumn.name;
+                });
+                ASSERT_NE(fullColumn, fullColumns.end());
+                for (size_t row = 0; row < full.getRowCount(); ++row) {
+                    EXPECT_EQ(projectedColumn.getText(row), fullColumn->getText(row)) << projectedColumn.name << " row " << row;
+                    expectSameNumber(fullColumn->getNumeric(row), projectedColumn.getNumeric(row), row);
+                }
+            }
+        }
+    }
+}
+
+TEST(PangaeaTable, parallelParsingMatchesSerial) {
+    auto parameters = createParameters({{"Event", ""}, {"LATITUDE", "deg"}, {"LONGITUDE", "deg"}, {"Depth", "m"}});
+
+    std::stringstream rows;
+    std::mt19937 random(2);
+    for (int i = 0; i < 5000; ++i) {
+        rows << "PS" << std::string(random() % 300, 'x') << "\t" << random() % 1000 / 7.0;
+        if (i % 7 != 0) {
+            rows << "\t" << random() % 100 << "\t" << random() % 1000 / 3.0;
+        }
+        rows << (i % 11 == 0 ? "\r\n" : "\n");
+    }
+    rows << "PS\t1\t2";
+    const std::string data = rows.str();
+
+    std::istringstream serialTextfile(data);
+    PangaeaTable serial(parameters);
+    serial.parse(serialTextfile, 1);
+
+    std::istringstream parallelTextfile(data);
+    PangaeaTable parallel(parameters);
+    parallel.parse(parallelTextfile, 4, 4096);
+
+    ASSERT_EQ(serial.getRowCount(), 5001);
+    ASSERT_EQ(serial.getRowCount(), parallel.getRowCount());
+
+    auto serialColumns = serial.getColumns();
+    auto parallelColumns = parallel.getColumns();
+    for (size_t column = 0; column < serialColumns.size(); ++column) {
+        for (size_t row = 0; row < serial.getRowCount(); ++row) {
+            EXPECT_EQ(serialColumns[column].getText(row), parallelColumns[column].getText(row));
+        }
+    }
+}
+
+TEST(PangaeaTable, memoryLimit) {
+    auto parameters = createParameters({{"Event", ""}, {"Depth", "m"}});
+
+    std::string data;
+    for (int i = 0; i < 10000; ++i) {
+        data += "PS" + std::to_string(i) + "\t" + std::to_string(i * 0.5) + "\n";
+    }
+
+    std::istringstream textfile(data);
+    PangaeaTable table(parameters);
+    table.setMemoryLimit(64 * 1024);
+    EXPECT_THROW(table.parse(textfile, 1), OperatorException);
+
+    std::istringstream parallelTextfile(data);
+    PangaeaTable parallel(parameters);
+    parallel.setMemoryLimit(64 * 1024);
+    EXPECT_THROW(parallel.parse(parallelTextfile, 4, 4096), OperatorException);
+
+    std::istringstream unlimitedTextfile(data);
+    PangaeaTable unlimited(parameters);
+    unlimited.setMemoryLimit(0);
+    unlimited.parse(unlimitedTextfile, 1);
+    EXPECT_EQ(unlimited.getRowCount(), 10000);
+    EXPECT_GT(unlimited.getMemoryUsage(), 64 * 1024);
+}
+
+TEST(PangaeaTable, columnarFileRoundTrip) {
+    auto parameters = createParameters({{"Event", ""}, {"LATITUDE", "deg"}, {"LONGITUDE", "deg"}, {"Depth", "m"}});
+
+    std::stringstream rows;
+    std::mt19937 random(3);
+    for (int i = 0; i < 3000; ++i) {
+        rows << "PS" << std::string(random() % 20, 'x') << i << "\t" << random() % 1800 / 10.0 - 90 << "\t"
+             << (i % 13 == 0 ? "" : std::to_string(random() % 3600 / 10.0 - 180)) << "\t"
+             << (i % 5 == 0 ? "n/a" : std::to_string(random() % 10000 / 3.0)) << "\n";
+    }
+    std::istringstream textfile(rows.str());
+    PangaeaTable table(parameters);
+    table.parse(textfile, 1);
+
+    const std::string path = ::testing::TempDir() + "pangaea_table_test.pgcol";
+    table.write(path, 1234, 5678);
+
+    EXPECT_TRUE(PangaeaColumnarFile::isUpToDate(path, 1234, 5678, parameters));
+    EXPECT_FALSE(PangaeaColumnarFile::isUpToDate(path, 1235, 5678, parameters));
+    EXPECT_FALSE(PangaeaColumnarFile::isUpToDate(path, 1234, 5678, createParameters({{"Event", ""}})));
+
+    PangaeaColumnarFile file(path);
+    ASSERT_EQ(file.getRowCount(), table.getRowCount());
+    EXPECT_TRUE(file.hasSpatialIndex("LONGITUDE", "LATITUDE"));
+
+    auto expected = table.getColumns();
+    auto &actual = file.getColumns();
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t column = 0; column < expected.size(); ++column) {
+        EXPECT_EQ(actual[column].name, expected[column].name);
+        EXPECT_EQ(actual[column].numeric, expected[column].numeric);
+        for (size_t row = 0; row < table.getRowCount(); ++row) {
+            EXPECT_EQ(actual[column].getText(row), expected[column].getText(row));
+            expectSameNumber(expected[column].getNumeric(row), actual[column].getNumeric(row), row);
+        }
+    }
+}
+
+TEST(PangaeaTable, columnarFileRejectsInvalidTextOffsets) {
+    auto parameters = createParameters({{"Event", ""}});
+
+    std::istringstream textfile("PS1\nPS2\nPS3\n");
+    PangaeaTable table(parameters);
+    table.parse(textfile, 1);
+
+    const std::string path = ::testing::TempDir() + "pangaea_table_offsets_test.pgcol";
+    table.write(path, 0, 0);
+    ASSERT_NO_THROW(PangaeaColumnarFile file(path));
+
+    std::string content;
+    {
+        std::ifstream in(path, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    // let the last field end behind the text of the column
+    const uint64_t offsets[] = {0, 3, 6, 9};
+    const std::string pattern(reinterpret_cast<const char *>(offsets), sizeof(offsets));
+    size_t position = content.find(pattern);
+    ASSERT_NE(position, std::string::npos);
+    const uint64_t invalid = 1 << 20;
+    content.replace(position + 3 * sizeof(uint64_t), sizeof(uint64_t), reinterpret_cast<const char *>(&invalid), sizeof(invalid));
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << content;
+    }
+
+    EXPECT_THROW(PangaeaColumnarFile file(path), OperatorException);
+}
+
+TEST(PangaeaTable, queryRowsMatchesFullScan) {
+    auto parameters = createParameters({{"Event", ""}, {"LATITUDE", "deg"}, {"LONGITUDE", "deg"}});
+
+    // coordinates on a lattice of 7.5 degrees, so that many points lie exactly on the edges of the
+    // rectangles and of the grid cells, which span 30 by 15 degrees for 2304 points from -180 to 180 and -90 to 90
+    std::stringstream rows;
+    std::mt19937 random(4);
+    rows << "PS\t-90\t-180\n" << "PS\t90\t180\n";
+    for (int i = 0; i < 2302; ++i) {
+        rows << "PS" << i << "\t" << static_cast<int>(random() % 25) * 7.5 - 90 << "\t";
+        if (i % 17 != 0) {
+            rows << static_cast<int>(random() % 49) * 7.5 - 180;
+        }
+        rows << "\n";
+    }
+    std::istringstream textfile(rows.str());
+    PangaeaTable table(parameters);
+    table.parse(textfile, 1);
+
+    const std::string path = ::testing::TempDir() + "pangaea_table_query_test.pgcol";
+    table.write(path, 0, 0);
+    PangaeaColumnarFile file(path);
+    ASSERT_TRUE(file.hasSpatialIndex("LONGITUDE", "LATITUDE"));
+
+    std::vector<std::vector<double>> rectangles = {
+            {-180, -90, 180, 90}, {-200, -100, 200, 100}, {0, 0, 0, 0}, {-30, -30, 30, 30}, {-60, 0, -30, 30},
+            {-37.5, -7.5, 7.5, 37.5}, {30, -90, 30, 90}, {-180, 60, 180, 60}, {180, 90, 180, 90}, {-180, -90, -180, -90},
+            {181, 0, 200, 10}, {-29.9, -29.9, 29.9, 29.9}, {10, 10, -10, -10}};
+    for (int i = 0; i < 200; ++i) {
+        double x1 = static_cast<int>(random() % 49) * 7.5 - 180, y1 = static_cast<int>(random() % 25) * 7.5 - 90;
+        rectangles.push_back({x1, y1, x1 + static_cast<int>(random() % 12) * 7.5, y1 + static_cast<int>(random() % 8) * 7.5});
+    }
+
+    auto &columns = file.getColumns();
+    for (auto &rectangle : rectangles) {
+        std::vector<size_t> expected;
+        for (size_t row = 0; row < file.getRowCount(); ++row) {
+            double x = columns[2].getNumeric(row), y = columns[1].getNumeric(row);
+            if (x >= rectangle[0] && x <= rectangle[2] && y >= rectangle[1] && y <= rectangle[3]) {
+                expected.push_back(row);
+            }
+        }
+
+        EXPECT_EQ(expected, file.queryRows(rectangle[0], rectangle[1], rectangle[2], rectangle[3]))
+                << rectangle[0] << " " << rectangle[1] << " " << rectangle[2] << " " << rectangle[3];
+    }
+}
@@ -1,5 +1,6 @@
 
 #include "util/terminology.h"
+#include "util/terminologysnapshot.h"
 #include <gtest/gtest.h>
 
 TEST(Terminology, requestLabel){
@@ -30,3 +31,97 @@ TEST(Terminology, multiplerequests){
     }
     EXPECT_EQ(names_out[num*2], "");
 }
+
+TEST(Terminology, cacheSeparatesQueries){
+    TerminologyCache::Query label{"NCBITAXON", "label", "exact", true};
+    TerminologyCache::Query uri{"NCBITAXON", "uri", "exact", true};
+
+    std::map<std::string, TerminologyCache::Resolution> stored;
+    stored["cached plum"] = {TerminologyCache::Resolution::State::RESOLVED, "Prunus domestica"};
+    stored["cached dose"] = {TerminologyCache::Resolution::State::NOT_RESOLVABLE, ""};
+    stored["cached bee"] = {TerminologyCache::Resolution::State::FAILED, ""};
+    TerminologyCache::put(label, stored);
+
+    std::set<std::string> names{"cached plum", "cached dose", "cached bee"};
+    std::map<std::string, TerminologyCache::Resolution> found;
+    TerminologyCache::get(label, names, found);
+
+    EXPECT_TRUE(names.empty());
+    ASSERT_EQ(found.size(), 3);
+    EXPECT_EQ(found["cached plum"].label, "Prunus domestica");
+    EXPECT_TRUE(found["cached dose"].state == TerminologyCache::Resolution::State::NOT_RESOLVABLE);
+    // failures are cached briefly, so a failing service is not asked again right away
+    EXPECT_TRUE(found["cached bee"].state == TerminologyCache::Resolution::State::FAILED);
+
+    std::set<std::string> other_names{"cached plum"};
+    std::map<std::string, TerminologyCache::Resolution> other_found;
+    TerminologyCache::get(uri, other_names, other_found);
+    EXPECT_TRUE(other_found.empty());
+}
+
+/**
+ * a snapshot of three terms, the second shares the synonym "fir" with the first
+ */
+static std::string writeSnapshot() {
+    const std::string path = ::testing::TempDir() + "terminology_snapshot_test.snapshot";
+    const std::string document = R"({"request": {"terminology": "TEST"}, "results": [
+        {"label": "Abies alba", "uri": "http://example.org/1", "synonyms": ["Silver Fir", "Fir"], "rank": "species"},
+        {"label": "Fir", "uri": ["http://example.org/2", "http://example.org/other"], "commonNames": "Tanne"},
+        {"label": "Quercus robur", "uri": "http://example.org/3", "synonyms": null}
+    ]})";
+    EXPECT_EQ(TerminologySnapshot::write(path, document, {"label", "uri"}), 3);
+    return path;
+}
+
+static std::map<std::string, TerminologyCache::Resolution> resolveWithSnapshot(const TerminologySnapshot &snapshot,
+                                                                                const TerminologyCache::Query &query,
+                                                                                std::set<std::string> &names,
+                                                                                bool remoteFallback = true) {
+    std::map<std::string, TerminologyCache::Resolution> resolutions;
+    snapshot.resolve(query, names, resolutions, remoteFallback);
+    return resolutions;
+}
+
+TEST(TerminologySnapshot, exactIgnoresCaseAndTakesFirstTerm){
+    TerminologySnapshot snapshot(writeSnapshot());
+    std::set<std::string> names{"SILVER FIR", "fir", "tanne", "oak"};
+    auto resolutions = resolveWithSnapshot(snapshot, {"TEST", "uri", "exact", true}, names);
+
+    EXPECT_EQ(resolutions.at("SILVER FIR").label, "http://example.org/1");
+    EXPECT_EQ(resolutions.at("fir").label, "http://example.org/1");
+    EXPECT_EQ(resolutions.at("tanne").label, "http://example.org/2");
+    EXPECT_EQ(resolutions.at("tanne").state, TerminologyCache::Resolution::State::RESOLVED);
+    EXPECT_EQ(names, std::set<std::string>{"oak"});
+}
+
+TEST(TerminologySnapshot, includedAndRegexAreLeftForTheService){
+    TerminologySnapshot snapshot(writeSnapshot());
+    const std::string longPattern(300, 'a');
+    for (auto &matchType : {"included", "regex"}) {
+        // names the snapshot did not search stay with the service even without remote fallback
+        std::set<std::string> names{"ERCUS", "fir", "^QUERCUS", "(invalid", longPattern};
+        auto resolutions = resolveWithSnapshot(snapshot, {"TEST", "label", matchType, true}, names, false);
+
+        EXPECT_TRUE(resolutions.empty());
+        EXPECT_EQ(names, (std::set<std::string>{"ERCUS", "fir", "^QUERCUS", "(invalid", longPattern}));
+    }
+}
+
+TEST(TerminologySnapshot, keysThatAreNotStoredAreLeftForTheService){
+    TerminologySnapshot snapshot(writeSnapshot());
+    std::set<std::string> names{"fir"};
+    auto resolutions = resolveWithSnapshot(snapshot, {"TEST", "rank", "exact", true}, names, false);
+
+    EXPECT_TRUE(resolutions.empty());
+    EXPECT_EQ(names, std::set<std::string>{"fir"});
+}
+
+TEST(TerminologySnapshot, withoutRemoteFallback){
+    TerminologySnapshot snapshot(writeSnapshot());
+    std::set<std::string> names{"fir", "oak"};
+    auto resolutions = resolveWithSnapshot(snapshot, {"TEST", "label", "exact", true}, names, false);
+
+    EXPECT_TRUE(names.empty());
+    EXPECT_EQ(resolutions.at("fir").label, "Abies alba");
+    EXPECT_EQ(resolutions.at("oak").state, TerminologyCache::Resolution::State::NOT_RESOLVABLE);
+}
@@ -0,0 +1,50 @@
+#include "operators/operator.h"
+#include <gtest/gtest.h>
+#include <json/json.h>
+
+static std::unique_ptr<GenericOperator> createResolver(const std::string &params) {
+    return GenericOperator::fromJSON(R"({"type": "terminology_resolver", "params": )" + params + "}");
+}
+
+TEST(TerminologyResolver, acceptsMappings){
+    EXPECT_NO_THROW(createResolver(R"({"on_not_resolvable": "KEEP", "mappings": [
+        {"attribute_name": "Name", "resolved_attribute": "ncbi_label", "terminology": "NCBITAXON"},
+        {"attribute_name": "Name", "resolved_attribute": "pesi_label", "terminology": "PESI"},
+        {"attribute_name": "Habitat", "resolved_attribute": "habitat_uri", "terminology": "ENVO", "key": "uri"}
+    ]})"));
+}
+
+TEST(TerminologyResolver, singleMappingKeepsSemanticId){
+    auto legacy = createResolver(R"({"attribute_name": "Name", "resolved_attribute": "label",
+        "terminology": "NCBITAXON", "on_not_resolvable": "KEEP"})");
+    auto mapped = createResolver(R"({"on_not_resolvable": "KEEP", "mappings": [
+        {"attribute_name": "Name", "resolved_attribute": "label", "terminology": "NCBITAXON"}
+    ]})");
+
+    EXPECT_EQ(legacy->getSemanticId(), mapped->getSemanticId());
+}
+
+TEST(TerminologyResolver, rejectsDuplicateResolvedAttributes){
+    EXPECT_ANY_THROW(createResolver(R"({"on_not_resolvable": "KEEP", "mappings": [
+        {"attribute_name": "Name", "resolved_attribute": "label", "terminology": "NCBITAXON"},
+        {"attribute_name": "Habitat", "resolved_attribute": "label", "terminology": "ENVO"}
+    ]})"));
+}
+
+TEST(TerminologyResolver, rejectsShadowingResolvedAttributes){
+    EXPECT_ANY_THROW(createResolver(R"({"on_not_resolvable": "KEEP", "mappings": [
+        {"attribute_name": "Name", "resolved_attribute": "Habitat", "terminology": "NCBITAXON"},
+        {"attribute_name": "Habitat", "resolved_attribute": "habitat_label", "terminology": "ENVO"}
+    ]})"));
+    EXPECT_ANY_THROW(createResolver(R"({"on_not_resolvable": "KEEP", "mappings": [
+        {"attribute_name": "Name", "resolved_attribute": "Name", "terminology": "NCBITAXON"}
+    ]})"));
+}
+
+TEST(TerminologyResolver, rejectsInvalidMappings){
+    EXPECT_ANY_THROW(createResolver(R"({"on_not_resolvable": "KEEP", "mappings": []})"));
+    EXPECT_ANY_THROW(createResolver(R"({"on_not_resolvable": "KEEP", "mappings": ["Name"]})"));
+    EXPECT_ANY_THROW(createResolver(R"({"on_not_resolvable": "KEEP", "mappings": [
+        {"attribute_name": "Name", "resolved_attribute": "label", "terminology": "NCBITAXON,PESI"}
+    ]})"));
+}